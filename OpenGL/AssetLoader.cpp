@@ -0,0 +1,228 @@
+#include <string.h>
+#include <algorithm>
+
+#include "AssetLoader.h"
+
+AssetLoader::AssetLoader()
+{
+	uploadBudget = 0;
+	pixelBuffers[0] = 0;
+	pixelBuffers[1] = 0;
+	nextPixelBuffer = 0;
+	pendingCount = 0;
+	uploading = nullptr;
+	stopping = false;
+}
+
+void AssetLoader::start(unsigned int numWorkers, size_t uploadBudgetPerFrame)
+{
+	stop();
+
+	uploadBudget = uploadBudgetPerFrame;
+	stopping = false;
+
+	// Two buffers, so filling one never waits on the GPU still reading the other
+	glGenBuffers(2, pixelBuffers);
+	nextPixelBuffer = 0;
+
+	for (unsigned int i = 0; i < std::max(numWorkers, 1u); i++)
+	{
+		workers.push_back(std::thread(&AssetLoader::workerLoop, this));
+	}
+}
+
+void AssetLoader::loadTexture(Texture* texture)
+{
+	// Usable straight away, the real image replaces it in place
+	texture->CreatePlaceholder();
+
+	TextureLoadRequest* request = new TextureLoadRequest();
+	request->texture = texture;
+	request->pixels = nullptr;
+	request->width = 0;
+	request->height = 0;
+	request->uploadedRows = 0;
+	request->requestTime = std::chrono::steady_clock::now();
+
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		decodeQueue.push_back(request);
+	}
+	queueCondition.notify_one();
+
+	pendingCount++;
+}
+
+void AssetLoader::update()
+{
+	size_t budgetLeft = uploadBudget;
+
+	while (budgetLeft > 0)
+	{
+		if (!uploading)
+		{
+			{
+				std::lock_guard<std::mutex> lock(queueMutex);
+				if (decodedQueue.empty())
+				{
+					break;
+				}
+
+				uploading = decodedQueue.front();
+				decodedQueue.pop_front();
+			}
+
+			if (!uploading->pixels)
+			{
+				printf("Failed to find: %s\n", uploading->texture->GetFileLocation());
+				finishRequest(uploading);
+				uploading = nullptr;
+				continue;
+			}
+
+			uploading->texture->AllocateStorage(uploading->width, uploading->height);
+		}
+
+		// Always at least one row, so a texture wider than the budget still makes progress
+		size_t rowBytes = (size_t)uploading->width * 4;
+		int rowsLeft = uploading->height - uploading->uploadedRows;
+		int numRows = (int)std::min((size_t)rowsLeft, std::max(budgetLeft / rowBytes, (size_t)1));
+
+		uploadRows(uploading, numRows);
+		budgetLeft -= std::min(budgetLeft, numRows * rowBytes);
+
+		if (uploading->uploadedRows == uploading->height)
+		{
+			uploading->texture->FinishUpload();
+
+			float milliseconds = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - uploading->requestTime).count();
+			printf("Loaded texture %s (%d x %d) %.1f ms after request\n",
+				uploading->texture->GetFileLocation(), uploading->width, uploading->height, milliseconds);
+
+			finishRequest(uploading);
+			uploading = nullptr;
+		}
+	}
+}
+
+void AssetLoader::uploadRows(TextureLoadRequest* request, int numRows)
+{
+	size_t size = (size_t)request->width * 4 * numRows;
+	const unsigned char* source = request->pixels + (size_t)request->width * 4 * request->uploadedRows;
+
+	GLStateCache::bindBuffer(GL_PIXEL_UNPACK_BUFFER, pixelBuffers[nextPixelBuffer]);
+	nextPixelBuffer = (nextPixelBuffer + 1) % 2;
+
+	// Orphan the buffer's old storage so the driver never has to wait for it
+	glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+	void* mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+
+	if (mapped)
+	{
+		memcpy(mapped, source, size);
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+		// Pixels now come from offset 0 of the bound buffer
+		request->texture->UploadRows(request->uploadedRows, numRows, nullptr);
+		GLStateCache::bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	}
+	else
+	{
+		GLStateCache::bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		request->texture->UploadRows(request->uploadedRows, numRows, source);
+	}
+
+	request->uploadedRows += numRows;
+}
+
+void AssetLoader::finishRequest(TextureLoadRequest* request)
+{
+	if (request->pixels)
+	{
+		stbi_image_free(request->pixels);
+	}
+
+	delete request;
+	pendingCount--;
+}
+
+void AssetLoader::workerLoop()
+{
+	while (true)
+	{
+		TextureLoadRequest* request;
+
+		{
+			std::unique_lock<std::mutex> lock(queueMutex);
+			queueCondition.wait(lock, [this] { return stopping || !decodeQueue.empty(); });
+
+			if (stopping)
+			{
+				return;
+			}
+
+			request = decodeQueue.front();
+			decodeQueue.pop_front();
+		}
+
+		// Always decode to RGBA so every texture uploads the same way
+		int channels;
+		request->pixels = stbi_load(request->texture->GetFileLocation(), &request->width, &request->height, &channels, 4);
+
+		std::lock_guard<std::mutex> lock(queueMutex);
+		decodedQueue.push_back(request);
+	}
+}
+
+unsigned int AssetLoader::getPendingCount()
+{
+	return pendingCount;
+}
+
+void AssetLoader::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		stopping = true;
+	}
+	queueCondition.notify_all();
+
+	for (size_t i = 0; i < workers.size(); i++)
+	{
+		workers[i].join();
+	}
+	workers.clear();
+
+	// Anything not finished keeps its placeholder
+	if (uploading)
+	{
+		finishRequest(uploading);
+		uploading = nullptr;
+	}
+
+	for (size_t i = 0; i < decodeQueue.size(); i++)
+	{
+		finishRequest(decodeQueue[i]);
+	}
+	decodeQueue.clear();
+
+	for (size_t i = 0; i < decodedQueue.size(); i++)
+	{
+		finishRequest(decodedQueue[i]);
+	}
+	decodedQueue.clear();
+
+	if (pixelBuffers[0] != 0)
+	{
+		glDeleteBuffers(2, pixelBuffers);
+		GLStateCache::forgetBuffer(pixelBuffers[0]);
+		GLStateCache::forgetBuffer(pixelBuffers[1]);
+		pixelBuffers[0] = 0;
+		pixelBuffers[1] = 0;
+	}
+}
+
+AssetLoader::~AssetLoader()
+{
+	stop();
+}
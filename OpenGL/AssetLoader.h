@@ -0,0 +1,62 @@
+#pragma once
+
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <chrono>
+#include <condition_variable>
+
+#include <GL\glew.h>
+
+#include "Texture.h"
+
+// A texture on its way from disk to the GPU
+struct TextureLoadRequest
+{
+	Texture* texture;
+	unsigned char* pixels;
+	int width, height;
+	int uploadedRows;
+	std::chrono::steady_clock::time_point requestTime;
+};
+
+// Loads textures without stalling the render thread.
+// Images are decoded on worker threads, then copied into pixel buffer objects and
+// uploaded a band of rows at a time, never more than the per-frame byte budget.
+// Textures show a 1x1 placeholder until their last row is in.
+class AssetLoader
+{
+public:
+	AssetLoader();
+
+	void start(unsigned int numWorkers, size_t uploadBudgetPerFrame);
+	void loadTexture(Texture* texture);
+	void update();
+	void stop();
+
+	unsigned int getPendingCount();
+
+	~AssetLoader();
+
+private:
+	size_t uploadBudget;
+	GLuint pixelBuffers[2];
+	unsigned int nextPixelBuffer;
+	unsigned int pendingCount;
+
+	// Render thread only
+	TextureLoadRequest* uploading;
+
+	// Shared with the workers, guarded by queueMutex
+	std::vector<std::thread> workers;
+	std::mutex queueMutex;
+	std::condition_variable queueCondition;
+	std::deque<TextureLoadRequest*> decodeQueue;
+	std::deque<TextureLoadRequest*> decodedQueue;
+	bool stopping;
+
+	void workerLoop();
+	void uploadRows(TextureLoadRequest* request, int numRows);
+	void finishRequest(TextureLoadRequest* request);
+};
@@ -0,0 +1,72 @@
+#include <stdio.h>
+
+#include "Benchmark.h"
+
+Benchmark::Benchmark()
+{
+	name = "";
+	reportInterval = 0;
+	sampleCount = 0;
+	lastMilliseconds = 0.0;
+	totalMilliseconds = 0.0;
+}
+
+Benchmark::Benchmark(std::string benchName, unsigned int reportEvery)
+{
+	name = benchName;
+	reportInterval = reportEvery;
+	sampleCount = 0;
+	lastMilliseconds = 0.0;
+	totalMilliseconds = 0.0;
+}
+
+void Benchmark::start()
+{
+	startTime = std::chrono::steady_clock::now();
+}
+
+void Benchmark::stop()
+{
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - startTime;
+
+	lastMilliseconds = elapsed.count();
+	totalMilliseconds += lastMilliseconds;
+	sampleCount++;
+
+	// Print and start a fresh window once enough samples are collected
+	if (reportInterval != 0 && sampleCount >= reportInterval)
+	{
+		report();
+		reset();
+	}
+}
+
+double Benchmark::getLastMilliseconds()
+{
+	return lastMilliseconds;
+}
+
+double Benchmark::getAverageMilliseconds()
+{
+	if (sampleCount == 0)
+	{
+		return 0.0;
+	}
+
+	return totalMilliseconds / sampleCount;
+}
+
+void Benchmark::report()
+{
+	printf("[Benchmark] %s: %.4f ms avg over %u sample(s)\n", name.c_str(), getAverageMilliseconds(), sampleCount);
+}
+
+void Benchmark::reset()
+{
+	sampleCount = 0;
+	totalMilliseconds = 0.0;
+}
+
+Benchmark::~Benchmark()
+{
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+
+// Accumulates CPU timings for a named section of code
+// and prints the average every reportEvery samples
+class Benchmark
+{
+public:
+	Benchmark();
+	Benchmark(std::string benchName, unsigned int reportEvery);
+
+	void start();
+	void stop();
+
+	double getLastMilliseconds();
+	double getAverageMilliseconds();
+
+	void report();
+	void reset();
+
+	~Benchmark();
+
+private:
+	std::string name;
+	unsigned int reportInterval;
+	unsigned int sampleCount;
+
+	double lastMilliseconds;
+	double totalMilliseconds;
+
+	std::chrono::steady_clock::time_point startTime;
+};
@@ -16,4 +16,37 @@ CONTROLS:
 	Bigger -> Left Shift
 	Smaller -> Left Control
 
+	TERRAIN:
+	Toggle draw mode (per strip / primitive restart) -> T
+	Toggle level of detail -> Y
+
+	VERTEX MATRICES:
+	Toggle per object (CPU) / per vertex (shader) matrices -> M
+
+	SHADERS:
+	Saving Shaders/shader.vert or Shaders/shader.frag while running rebuilds and swaps in every program
+
+	INSTANCING STRESS SCENE:
+	Toggle instanced / per mesh drawing -> N
+
+COMMAND LINE:
+
+	--bench-heightmaps      Time heightmap decode and generation, then exit
+	--bench-heightmap-formats
+	                        Time loading each heightmap as PNG against its .hmt, then exit
+	--bench-terrain-normals Time scalar, SSE and multithreaded terrain normal generation, then exit
+	--bench-transforms      Time building world matrices with GLM, the SSE kernel and the SSE kernel on all cores, then exit
+	--convert-heightmaps    Convert every heightmap in Heightmaps/ to a tiled .hmt file, then exit
+	--convert-heightmap IN OUT
+	                        Convert one image heightmap to a tiled .hmt file, then exit
+	--heightmap FILE        Heightmap to load (.png or .hmt)
+	--no-terrain-bake       Always regenerate the terrain instead of using or writing its .terrainbake file
+	--no-shader-cache       Always compile shaders from source instead of using or writing .programbin files
+	--stream-terrain        Page terrain tiles in around the camera instead of loading the whole map
+	--stream-budget-mb N    Memory budget for streamed tiles (default 256)
+	--report-gl-state       Print how many GL binds were issued and how many the state cache skipped, and the
+	                        render queue's state changes before and after sorting, every 5 seconds
+	--indirect-draws        Submit the terrain and stress scene with glMultiDrawElementsIndirect when supported
+	--instancing-stress N   Draw N extra cubes, unculled, and report frame times for each way of drawing them
+
 */
\ No newline at end of file
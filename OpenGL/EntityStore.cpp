@@ -0,0 +1,240 @@
+#include "EntityStore.h"
+
+EntityStore::EntityStore()
+{
+	parent = nullptr;
+	parentVersion = 0;
+	allDirty = false;
+}
+
+Entity EntityStore::createEntity(Mesh* mesh, Texture* texture, Material* material, const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+{
+	Entity entity = (Entity)positions.size();
+
+	positions.push_back(glm::vec3(0.0f));
+	rotations.push_back(glm::vec3(0.0f));
+	scales.push_back(glm::vec3(1.0f));
+	worldMatrices.push_back(glm::mat4(1.0f));
+	normalMatrices.push_back(glm::mat3(1.0f));
+	mvpMatrices.push_back(glm::mat4(1.0f));
+	dirtyFlags.push_back(0);
+
+	meshes.push_back(mesh);
+	textures.push_back(texture);
+	materials.push_back(material);
+
+	localBoundsMin.push_back(boundsMin);
+	localBoundsMax.push_back(boundsMax);
+	worldBoundsMin.push_back(boundsMin);
+	worldBoundsMax.push_back(boundsMax);
+
+	markDirty(entity);
+	return entity;
+}
+
+void EntityStore::markDirty(Entity entity)
+{
+	if (!dirtyFlags[entity])
+	{
+		dirtyFlags[entity] = 1;
+		dirtyEntities.push_back(entity);
+	}
+}
+
+void EntityStore::setPosition(Entity entity, const glm::vec3& position)
+{
+	if (positions[entity] != position)
+	{
+		positions[entity] = position;
+		markDirty(entity);
+	}
+}
+
+void EntityStore::setRotation(Entity entity, const glm::vec3& rotation)
+{
+	if (rotations[entity] != rotation)
+	{
+		rotations[entity] = rotation;
+		markDirty(entity);
+	}
+}
+
+void EntityStore::setScale(Entity entity, const glm::vec3& scale)
+{
+	if (scales[entity] != scale)
+	{
+		scales[entity] = scale;
+		markDirty(entity);
+	}
+}
+
+void EntityStore::setParent(Transform* newParent)
+{
+	if (newParent != parent)
+	{
+		parent = newParent;
+		allDirty = true;
+	}
+}
+
+glm::vec3 EntityStore::getPosition(Entity entity)
+{
+	return positions[entity];
+}
+
+glm::vec3 EntityStore::getRotation(Entity entity)
+{
+	return rotations[entity];
+}
+
+glm::vec3 EntityStore::getScale(Entity entity)
+{
+	return scales[entity];
+}
+
+const glm::mat4& EntityStore::getWorldMatrix(Entity entity)
+{
+	return worldMatrices[entity];
+}
+
+const glm::mat3& EntityStore::getNormalMatrix(Entity entity)
+{
+	return normalMatrices[entity];
+}
+
+glm::vec3 EntityStore::getLocalBoundsMin(Entity entity)
+{
+	return localBoundsMin[entity];
+}
+
+glm::vec3 EntityStore::getLocalBoundsMax(Entity entity)
+{
+	return localBoundsMax[entity];
+}
+
+void EntityStore::updateBounds(Entity entity)
+{
+	const glm::mat4& world = worldMatrices[entity];
+
+	// Box around the transformed box: move the centre, then add up how far
+	// each axis of the matrix stretches the extents
+	glm::vec3 centre = (localBoundsMin[entity] + localBoundsMax[entity]) * 0.5f;
+	glm::vec3 extents = (localBoundsMax[entity] - localBoundsMin[entity]) * 0.5f;
+
+	glm::vec3 worldCentre = glm::vec3(world * glm::vec4(centre, 1.0f));
+	glm::vec3 worldExtents = glm::abs(glm::vec3(world[0])) * extents.x +
+		glm::abs(glm::vec3(world[1])) * extents.y +
+		glm::abs(glm::vec3(world[2])) * extents.z;
+
+	worldBoundsMin[entity] = worldCentre - worldExtents;
+	worldBoundsMax[entity] = worldCentre + worldExtents;
+}
+
+void EntityStore::updateTransforms()
+{
+	glm::mat4 parentMatrix = glm::mat4(1.0f);
+
+	if (parent)
+	{
+		parentMatrix = parent->getWorldMatrix();
+
+		if (parent->getVersion() != parentVersion)
+		{
+			parentVersion = parent->getVersion();
+			allDirty = true;
+		}
+	}
+
+	// Matrices are built in one batch, straight from the component arrays
+	if (allDirty && !positions.empty())
+	{
+		transformKernel.compose(parentMatrix, &positions[0], &rotations[0], &scales[0], nullptr, positions.size(),
+			&worldMatrices[0], &normalMatrices[0]);
+
+		for (Entity entity = 0; entity < positions.size(); entity++)
+		{
+			updateBounds(entity);
+		}
+	}
+	else if (!dirtyEntities.empty())
+	{
+		transformKernel.compose(parentMatrix, &positions[0], &rotations[0], &scales[0], &dirtyEntities[0], dirtyEntities.size(),
+			&worldMatrices[0], &normalMatrices[0]);
+
+		for (size_t i = 0; i < dirtyEntities.size(); i++)
+		{
+			updateBounds(dirtyEntities[i]);
+		}
+	}
+
+	for (size_t i = 0; i < dirtyEntities.size(); i++)
+	{
+		dirtyFlags[dirtyEntities[i]] = 0;
+	}
+	dirtyEntities.clear();
+	allDirty = false;
+}
+
+void EntityStore::queueDraws(RenderQueue& renderQueue, Shader* shader, const glm::mat4& viewProjection, Frustum* frustum)
+{
+	visibleEntities.clear();
+
+	for (Entity entity = 0; entity < positions.size(); entity++)
+	{
+		if (frustum && !frustum->intersectsAABB(worldBoundsMin[entity], worldBoundsMax[entity]))
+		{
+			continue;
+		}
+
+		visibleEntities.push_back(entity);
+	}
+
+	if (visibleEntities.empty())
+	{
+		return;
+	}
+
+	transformKernel.multiply(viewProjection, &worldMatrices[0], &visibleEntities[0], visibleEntities.size(), &mvpMatrices[0]);
+
+	for (size_t i = 0; i < visibleEntities.size(); i++)
+	{
+		Entity entity = visibleEntities[i];
+		renderQueue.add(RENDER_PASS_OPAQUE, meshes[entity], shader, textures[entity], materials[entity],
+			worldMatrices[entity], mvpMatrices[entity], normalMatrices[entity]);
+	}
+}
+
+unsigned int EntityStore::getEntityCount()
+{
+	return (unsigned int)positions.size();
+}
+
+void EntityStore::clear()
+{
+	positions.clear();
+	rotations.clear();
+	scales.clear();
+	worldMatrices.clear();
+	normalMatrices.clear();
+	dirtyFlags.clear();
+	dirtyEntities.clear();
+
+	meshes.clear();
+	mvpMatrices.clear();
+	visibleEntities.clear();
+	textures.clear();
+	materials.clear();
+
+	localBoundsMin.clear();
+	localBoundsMax.clear();
+	worldBoundsMin.clear();
+	worldBoundsMax.clear();
+
+	parent = nullptr;
+	parentVersion = 0;
+	allDirty = false;
+}
+
+EntityStore::~EntityStore()
+{
+}
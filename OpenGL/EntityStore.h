@@ -0,0 +1,92 @@
+#pragma once
+
+#include <vector>
+
+#include <GL\glew.h>
+
+#include <glm\glm.hpp>
+
+#include "Mesh.h"
+#include "Texture.h"
+#include "Material.h"
+#include "Shader.h"
+#include "Transform.h"
+#include "TransformKernel.h"
+#include "Frustum.h"
+#include "RenderQueue.h"
+
+typedef unsigned int Entity;
+
+// Scene objects stored as one array per component (structure of arrays), indexed by Entity.
+// Systems walk whole arrays front to back, so the cost grows linearly with the entity count
+// and each system only touches the components it needs.
+class EntityStore
+{
+public:
+	EntityStore();
+
+	// boundsMin and boundsMax are the mesh's bounds in its own space
+	Entity createEntity(Mesh* mesh, Texture* texture, Material* material, const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+
+	void setPosition(Entity entity, const glm::vec3& position);
+	// Degrees about x, y then z
+	void setRotation(Entity entity, const glm::vec3& rotation);
+	void setScale(Entity entity, const glm::vec3& scale);
+	// Applied before every entity's own transform. Has to outlive the store.
+	void setParent(Transform* newParent);
+
+	glm::vec3 getPosition(Entity entity);
+	glm::vec3 getRotation(Entity entity);
+	glm::vec3 getScale(Entity entity);
+	const glm::mat4& getWorldMatrix(Entity entity);
+	const glm::mat3& getNormalMatrix(Entity entity);
+	glm::vec3 getLocalBoundsMin(Entity entity);
+	glm::vec3 getLocalBoundsMax(Entity entity);
+
+	// Transform system: rebuilds world matrices and world bounds of entities that changed
+	void updateTransforms();
+	// Render system: queues every entity, skipping those outside frustum when one is given.
+	// MVP matrices are built for the queued entities in one batch.
+	void queueDraws(RenderQueue& renderQueue, Shader* shader, const glm::mat4& viewProjection, Frustum* frustum);
+
+	unsigned int getEntityCount();
+
+	void clear();
+
+	~EntityStore();
+
+private:
+	// Transform. World = parent * translate * scale * rotateX * rotateY * rotateZ
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec3> rotations;
+	std::vector<glm::vec3> scales;
+	std::vector<glm::mat4> worldMatrices;
+	// Only changes with the world matrix, so it is built alongside it
+	std::vector<glm::mat3> normalMatrices;
+
+	// Entities to rebuild on the next update, each listed once
+	std::vector<unsigned char> dirtyFlags;
+	std::vector<Entity> dirtyEntities;
+
+	// Render. MVPs are rebuilt every frame, for the entities that passed culling.
+	std::vector<Mesh*> meshes;
+	std::vector<glm::mat4> mvpMatrices;
+	std::vector<Entity> visibleEntities;
+	std::vector<Texture*> textures;
+	std::vector<Material*> materials;
+
+	// Bounds
+	std::vector<glm::vec3> localBoundsMin;
+	std::vector<glm::vec3> localBoundsMax;
+	std::vector<glm::vec3> worldBoundsMin;
+	std::vector<glm::vec3> worldBoundsMax;
+
+	Transform* parent;
+	unsigned int parentVersion;
+	bool allDirty;
+
+	TransformKernel transformKernel;
+
+	void markDirty(Entity entity);
+	void updateBounds(Entity entity);
+};
@@ -0,0 +1,55 @@
+#include "Frustum.h"
+
+Frustum::Frustum()
+{
+	for (size_t i = 0; i < 6; i++)
+	{
+		planes[i] = glm::vec4(0.0f);
+	}
+}
+
+void Frustum::extractPlanes(const glm::mat4& clipMatrix)
+{
+	// GLM is column-major, so gather the rows of the matrix first
+	glm::vec4 rows[4];
+	for (int i = 0; i < 4; i++)
+	{
+		rows[i] = glm::vec4(clipMatrix[0][i], clipMatrix[1][i], clipMatrix[2][i], clipMatrix[3][i]);
+	}
+
+	planes[0] = rows[3] + rows[0];
+	planes[1] = rows[3] - rows[0];
+	planes[2] = rows[3] + rows[1];
+	planes[3] = rows[3] - rows[1];
+	planes[4] = rows[3] + rows[2];
+	planes[5] = rows[3] - rows[2];
+
+	for (size_t i = 0; i < 6; i++)
+	{
+		planes[i] /= glm::length(glm::vec3(planes[i]));
+	}
+}
+
+bool Frustum::intersectsAABB(const glm::vec3& minCorner, const glm::vec3& maxCorner)
+{
+	for (size_t i = 0; i < 6; i++)
+	{
+		// Test the corner furthest along the plane normal
+		glm::vec3 positive(
+			planes[i].x >= 0.0f ? maxCorner.x : minCorner.x,
+			planes[i].y >= 0.0f ? maxCorner.y : minCorner.y,
+			planes[i].z >= 0.0f ? maxCorner.z : minCorner.z
+		);
+
+		if (glm::dot(glm::vec3(planes[i]), positive) + planes[i].w < 0.0f)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+Frustum::~Frustum()
+{
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <glm\glm.hpp>
+
+// The six clipping planes of a camera, extracted from a clip matrix
+// (projection * view * model as used by the vertex shader)
+class Frustum
+{
+public:
+	Frustum();
+
+	void extractPlanes(const glm::mat4& clipMatrix);
+	bool intersectsAABB(const glm::vec3& minCorner, const glm::vec3& maxCorner);
+
+	~Frustum();
+
+private:
+	// Left, right, bottom, top, near, far. xyz = normal, w = distance
+	glm::vec4 planes[6];
+};
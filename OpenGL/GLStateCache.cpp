@@ -0,0 +1,202 @@
+#include <stdio.h>
+
+#include "GLStateCache.h"
+
+const GLuint UNKNOWN_BINDING = ~0u;
+
+GLuint GLStateCache::program = UNKNOWN_BINDING;
+GLuint GLStateCache::vertexArray = UNKNOWN_BINDING;
+GLuint GLStateCache::buffers[NUM_BUFFER_TARGETS] = { UNKNOWN_BINDING, UNKNOWN_BINDING, UNKNOWN_BINDING, UNKNOWN_BINDING, UNKNOWN_BINDING };
+GLuint GLStateCache::textures[NUM_TEXTURE_UNITS][NUM_TEXTURE_TARGETS];
+GLuint GLStateCache::activeUnit = UNKNOWN_BINDING;
+
+unsigned long long GLStateCache::issued = 0;
+unsigned long long GLStateCache::elided = 0;
+
+// Static storage starts zeroed, which would read as "texture 0 bound"
+static bool texturesInitialised = false;
+
+void GLStateCache::useProgram(GLuint newProgram)
+{
+	if (program == newProgram)
+	{
+		elided++;
+		return;
+	}
+
+	glUseProgram(newProgram);
+	program = newProgram;
+	issued++;
+}
+
+void GLStateCache::bindVertexArray(GLuint newVertexArray)
+{
+	if (vertexArray == newVertexArray)
+	{
+		elided++;
+		return;
+	}
+
+	glBindVertexArray(newVertexArray);
+	vertexArray = newVertexArray;
+	issued++;
+}
+
+void GLStateCache::bindBuffer(GLenum target, GLuint buffer)
+{
+	int slot = getBufferSlot(target);
+
+	if (slot >= 0 && buffers[slot] == buffer)
+	{
+		elided++;
+		return;
+	}
+
+	glBindBuffer(target, buffer);
+	if (slot >= 0)
+	{
+		buffers[slot] = buffer;
+	}
+	issued++;
+}
+
+void GLStateCache::bindTexture(GLuint unit, GLenum target, GLuint texture)
+{
+	if (!texturesInitialised)
+	{
+		invalidate();
+	}
+
+	// Callers follow the bind with glTexSubImage2D, glTexParameteri and the like, which act
+	// on the active unit, so it's switched to even when the bind itself is skipped
+	if (activeUnit != unit)
+	{
+		glActiveTexture(GL_TEXTURE0 + unit);
+		activeUnit = unit;
+		issued++;
+	}
+
+	int slot = getTextureSlot(target);
+
+	if (slot >= 0 && unit < NUM_TEXTURE_UNITS && textures[unit][slot] == texture)
+	{
+		elided++;
+		return;
+	}
+
+	glBindTexture(target, texture);
+	if (slot >= 0 && unit < NUM_TEXTURE_UNITS)
+	{
+		textures[unit][slot] = texture;
+	}
+	issued++;
+}
+
+void GLStateCache::forgetProgram(GLuint oldProgram)
+{
+	if (program == oldProgram)
+	{
+		program = UNKNOWN_BINDING;
+	}
+}
+
+void GLStateCache::forgetVertexArray(GLuint oldVertexArray)
+{
+	if (vertexArray == oldVertexArray)
+	{
+		vertexArray = UNKNOWN_BINDING;
+	}
+}
+
+void GLStateCache::forgetBuffer(GLuint buffer)
+{
+	for (int i = 0; i < NUM_BUFFER_TARGETS; i++)
+	{
+		if (buffers[i] == buffer)
+		{
+			buffers[i] = UNKNOWN_BINDING;
+		}
+	}
+}
+
+void GLStateCache::forgetTexture(GLuint texture)
+{
+	for (int unit = 0; unit < NUM_TEXTURE_UNITS; unit++)
+	{
+		for (int i = 0; i < NUM_TEXTURE_TARGETS; i++)
+		{
+			if (textures[unit][i] == texture)
+			{
+				textures[unit][i] = UNKNOWN_BINDING;
+			}
+		}
+	}
+}
+
+void GLStateCache::invalidate()
+{
+	program = UNKNOWN_BINDING;
+	vertexArray = UNKNOWN_BINDING;
+	activeUnit = UNKNOWN_BINDING;
+
+	for (int i = 0; i < NUM_BUFFER_TARGETS; i++)
+	{
+		buffers[i] = UNKNOWN_BINDING;
+	}
+
+	for (int unit = 0; unit < NUM_TEXTURE_UNITS; unit++)
+	{
+		for (int i = 0; i < NUM_TEXTURE_TARGETS; i++)
+		{
+			textures[unit][i] = UNKNOWN_BINDING;
+		}
+	}
+
+	texturesInitialised = true;
+}
+
+unsigned long long GLStateCache::getIssuedCount()
+{
+	return issued;
+}
+
+unsigned long long GLStateCache::getElidedCount()
+{
+	return elided;
+}
+
+void GLStateCache::report()
+{
+	unsigned long long total = issued + elided;
+	printf("GL state: %llu binds issued, %llu elided (%.1f%% skipped)\n",
+		issued, elided, total > 0 ? 100.0 * elided / total : 0.0);
+}
+
+void GLStateCache::resetCounters()
+{
+	issued = 0;
+	elided = 0;
+}
+
+int GLStateCache::getBufferSlot(GLenum target)
+{
+	switch (target)
+	{
+	case GL_ARRAY_BUFFER: return 0;
+	case GL_PIXEL_UNPACK_BUFFER: return 1;
+	case GL_DRAW_INDIRECT_BUFFER: return 2;
+	case GL_TEXTURE_BUFFER: return 3;
+	case GL_UNIFORM_BUFFER: return 4;
+	default: return -1;
+	}
+}
+
+int GLStateCache::getTextureSlot(GLenum target)
+{
+	switch (target)
+	{
+	case GL_TEXTURE_2D: return 0;
+	case GL_TEXTURE_BUFFER: return 1;
+	default: return -1;
+	}
+}
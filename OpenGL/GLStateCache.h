@@ -0,0 +1,48 @@
+#pragma once
+
+#include <GL\glew.h>
+
+// Remembers the bound program, VAO, buffers and textures so binding what is already bound
+// costs nothing. Every bind in the renderer has to go through here, or the cache goes stale;
+// call invalidate() after code that binds directly.
+// GL_ELEMENT_ARRAY_BUFFER belongs to the bound VAO, so binds to it are always issued.
+class GLStateCache
+{
+public:
+	static void useProgram(GLuint program);
+	static void bindVertexArray(GLuint vertexArray);
+	static void bindBuffer(GLenum target, GLuint buffer);
+	// Always leaves unit active, so calls that edit the bound texture act on it
+	static void bindTexture(GLuint unit, GLenum target, GLuint texture);
+
+	// Call after deleting an object, so a recycled name isn't mistaken for the bound one
+	static void forgetProgram(GLuint program);
+	static void forgetVertexArray(GLuint vertexArray);
+	static void forgetBuffer(GLuint buffer);
+	static void forgetTexture(GLuint texture);
+
+	static void invalidate();
+
+	static unsigned long long getIssuedCount();
+	static unsigned long long getElidedCount();
+	static void report();
+	static void resetCounters();
+
+private:
+	static const int NUM_BUFFER_TARGETS = 5;
+	static const int NUM_TEXTURE_TARGETS = 2;
+	static const int NUM_TEXTURE_UNITS = 16;
+
+	// Bound names. ~0 means unknown, so the next bind is always issued.
+	static GLuint program;
+	static GLuint vertexArray;
+	static GLuint buffers[NUM_BUFFER_TARGETS];
+	static GLuint textures[NUM_TEXTURE_UNITS][NUM_TEXTURE_TARGETS];
+	static GLuint activeUnit;
+
+	static unsigned long long issued;
+	static unsigned long long elided;
+
+	static int getBufferSlot(GLenum target);
+	static int getTextureSlot(GLenum target);
+};
@@ -0,0 +1,182 @@
+#include <stdio.h>
+#include <algorithm>
+
+#include "GeometryArena.h"
+#include "Mesh.h"
+
+GeometryArena::GeometryArena()
+{
+	format = GEOMETRY_FORMAT_MESH;
+	vertexSize = Mesh::getVertexSize(format);
+	blockVertices = 0;
+	blockIndices = 0;
+}
+
+GeometryArena::GeometryArena(GeometryFormat vertexFormat, size_t verticesPerBlock, size_t indicesPerBlock)
+{
+	format = vertexFormat;
+	vertexSize = Mesh::getVertexSize(format);
+	blockVertices = verticesPerBlock;
+	blockIndices = indicesPerBlock;
+}
+
+void GeometryArena::init(GeometryFormat vertexFormat, size_t verticesPerBlock, size_t indicesPerBlock)
+{
+	clear();
+
+	format = vertexFormat;
+	vertexSize = Mesh::getVertexSize(format);
+	blockVertices = verticesPerBlock;
+	blockIndices = indicesPerBlock;
+}
+
+bool GeometryArena::allocate(const void* vertices, size_t numVertices, const GLuint* indices, size_t numIndices,
+	GeometryAllocation& allocation)
+{
+	allocation.block = -1;
+
+	int block = -1;
+
+	for (size_t i = 0; i < blocks.size(); i++)
+	{
+		if (blocks[i].usedVertices + numVertices <= blocks[i].vertexCapacity &&
+			blocks[i].usedIndices + numIndices <= blocks[i].indexCapacity)
+		{
+			block = (int)i;
+			break;
+		}
+	}
+
+	// Meshes bigger than a block get a block of their own
+	if (block < 0)
+	{
+		block = createBlock(std::max(blockVertices, numVertices), std::max(blockIndices, numIndices));
+		if (block < 0)
+		{
+			return false;
+		}
+	}
+
+	GeometryBlock& target = blocks[block];
+
+	// The VAO keeps its element buffer binding, so binding it brings the IBO along
+	bind(block);
+
+	GLStateCache::bindBuffer(GL_ARRAY_BUFFER, target.VBO);
+	glBufferSubData(GL_ARRAY_BUFFER, target.usedVertices * vertexSize, numVertices * vertexSize, vertices);
+
+	glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, target.usedIndices * sizeof(GLuint), numIndices * sizeof(GLuint), indices);
+
+	allocation.block = block;
+	allocation.baseVertex = (GLint)target.usedVertices;
+	allocation.firstIndex = (GLuint)target.usedIndices;
+	allocation.indexCount = (GLsizei)numIndices;
+
+	target.usedVertices += numVertices;
+	target.usedIndices += numIndices;
+
+	return true;
+}
+
+bool GeometryArena::bind(int block)
+{
+	if (block < 0 || block >= (int)blocks.size())
+	{
+		return false;
+	}
+
+	GLStateCache::bindVertexArray(blocks[block].VAO);
+	return true;
+}
+
+void GeometryArena::draw(const GeometryAllocation& allocation)
+{
+	if (!bind(allocation.block))
+	{
+		return;
+	}
+	glDrawElementsBaseVertex(GL_TRIANGLES, allocation.indexCount, GL_UNSIGNED_INT,
+		(void*)(sizeof(GLuint) * allocation.firstIndex), allocation.baseVertex);
+}
+
+size_t GeometryArena::getBlockCount()
+{
+	return blocks.size();
+}
+
+size_t GeometryArena::getUsedBytes()
+{
+	size_t used = 0;
+	for (size_t i = 0; i < blocks.size(); i++)
+	{
+		used += blocks[i].usedVertices * vertexSize + blocks[i].usedIndices * sizeof(GLuint);
+	}
+
+	return used;
+}
+
+size_t GeometryArena::getCapacityBytes()
+{
+	size_t capacity = 0;
+	for (size_t i = 0; i < blocks.size(); i++)
+	{
+		capacity += blocks[i].vertexCapacity * vertexSize + blocks[i].indexCapacity * sizeof(GLuint);
+	}
+
+	return capacity;
+}
+
+int GeometryArena::createBlock(size_t vertexCapacity, size_t indexCapacity)
+{
+	GeometryBlock block;
+	block.vertexCapacity = vertexCapacity;
+	block.indexCapacity = indexCapacity;
+	block.usedVertices = 0;
+	block.usedIndices = 0;
+
+	glGenVertexArrays(1, &block.VAO);
+	GLStateCache::bindVertexArray(block.VAO);
+
+	glGenBuffers(1, &block.VBO);
+	GLStateCache::bindBuffer(GL_ARRAY_BUFFER, block.VBO);
+	glBufferData(GL_ARRAY_BUFFER, vertexCapacity * vertexSize, nullptr, GL_STATIC_DRAW);
+
+	glGenBuffers(1, &block.IBO);
+	GLStateCache::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, block.IBO);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCapacity * sizeof(GLuint), nullptr, GL_STATIC_DRAW);
+
+	if (glGetError() == GL_OUT_OF_MEMORY)
+	{
+		printf("Failed to allocate geometry block (%zu vertices, %zu indices)\n", vertexCapacity, indexCapacity);
+		glDeleteBuffers(1, &block.VBO);
+		glDeleteBuffers(1, &block.IBO);
+		glDeleteVertexArrays(1, &block.VAO);
+		GLStateCache::forgetBuffer(block.VBO);
+		GLStateCache::forgetVertexArray(block.VAO);
+		return -1;
+	}
+
+	Mesh::setVertexAttributes(format);
+
+	blocks.push_back(block);
+	return (int)blocks.size() - 1;
+}
+
+void GeometryArena::clear()
+{
+	for (size_t i = 0; i < blocks.size(); i++)
+	{
+		glDeleteBuffers(1, &blocks[i].VBO);
+		glDeleteBuffers(1, &blocks[i].IBO);
+		glDeleteVertexArrays(1, &blocks[i].VAO);
+		GLStateCache::forgetBuffer(blocks[i].VBO);
+		GLStateCache::forgetVertexArray(blocks[i].VAO);
+	}
+
+	blocks.clear();
+}
+
+GeometryArena::~GeometryArena()
+{
+	clear();
+}
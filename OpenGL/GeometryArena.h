@@ -0,0 +1,74 @@
+#pragma once
+
+#include <vector>
+
+#include <GL\glew.h>
+
+#include "GLStateCache.h"
+
+// Vertex layouts an arena can hold. Each arena holds one layout.
+enum GeometryFormat
+{
+	GEOMETRY_FORMAT_MESH,
+	GEOMETRY_FORMAT_TERRAIN
+};
+
+// Where a mesh was placed inside an arena
+struct GeometryAllocation
+{
+	int block;
+	GLint baseVertex;
+	GLuint firstIndex;
+	GLsizei indexCount;
+};
+
+// Suballocates static meshes out of a few large vertex and index buffers. Every block
+// has one VAO, so meshes in the same block draw back to back with glDrawElementsBaseVertex
+// and no buffer binds in between. Space is only given back by clear().
+class GeometryArena
+{
+public:
+	GeometryArena();
+	GeometryArena(GeometryFormat vertexFormat, size_t verticesPerBlock, size_t indicesPerBlock);
+
+	// The arena owns its VAOs and buffers, so copies would delete them twice
+	GeometryArena(const GeometryArena&) = delete;
+	GeometryArena& operator=(const GeometryArena&) = delete;
+
+	// Frees every block and starts over with a new format and block size
+	void init(GeometryFormat vertexFormat, size_t verticesPerBlock, size_t indicesPerBlock);
+
+	// Copies the mesh into the first block with room, opening a new block when none has.
+	// On failure allocation.block is -1.
+	bool allocate(const void* vertices, size_t numVertices, const GLuint* indices, size_t numIndices,
+		GeometryAllocation& allocation);
+
+	// Binds the block's VAO through the state cache, so back to back draws from one block bind once.
+	// False, binding nothing, if block isn't one of this arena's.
+	bool bind(int block);
+
+	void draw(const GeometryAllocation& allocation);
+
+	size_t getBlockCount();
+	size_t getUsedBytes();
+	size_t getCapacityBytes();
+
+	void clear();
+
+	~GeometryArena();
+
+private:
+	struct GeometryBlock
+	{
+		GLuint VAO, VBO, IBO;
+		size_t vertexCapacity, indexCapacity;
+		size_t usedVertices, usedIndices;
+	};
+
+	std::vector<GeometryBlock> blocks;
+	GeometryFormat format;
+	size_t vertexSize;
+	size_t blockVertices, blockIndices;
+
+	int createBlock(size_t vertexCapacity, size_t indexCapacity);
+};
@@ -0,0 +1,140 @@
+#include <stdio.h>
+
+#include "GpuBenchmark.h"
+
+GpuBenchmark::GpuBenchmark()
+{
+	name = "";
+	reportInterval = 0;
+	sampleCount = 0;
+	totalMilliseconds = 0.0;
+
+	for (int i = 0; i < QUERY_COUNT; i++)
+	{
+		queries[i] = 0;
+		pending[i] = false;
+	}
+	nextQuery = 0;
+	running = false;
+}
+
+GpuBenchmark::GpuBenchmark(std::string benchName, unsigned int reportEvery)
+{
+	name = benchName;
+	reportInterval = reportEvery;
+	sampleCount = 0;
+	totalMilliseconds = 0.0;
+
+	for (int i = 0; i < QUERY_COUNT; i++)
+	{
+		queries[i] = 0;
+		pending[i] = false;
+	}
+	nextQuery = 0;
+	running = false;
+}
+
+void GpuBenchmark::start()
+{
+	if (queries[0] == 0)
+	{
+		glGenQueries(QUERY_COUNT, queries);
+	}
+
+	collectResults();
+
+	// Every query is still in flight, so this sample is skipped rather than stalling
+	if (pending[nextQuery])
+	{
+		return;
+	}
+
+	glBeginQuery(GL_TIME_ELAPSED, queries[nextQuery]);
+	running = true;
+}
+
+void GpuBenchmark::stop()
+{
+	if (!running)
+	{
+		return;
+	}
+
+	glEndQuery(GL_TIME_ELAPSED);
+	pending[nextQuery] = true;
+	nextQuery = (nextQuery + 1) % QUERY_COUNT;
+	running = false;
+}
+
+void GpuBenchmark::collectResults()
+{
+	for (int i = 0; i < QUERY_COUNT; i++)
+	{
+		if (!pending[i])
+		{
+			continue;
+		}
+
+		GLint available = 0;
+		glGetQueryObjectiv(queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available)
+		{
+			continue;
+		}
+
+		GLuint64 nanoseconds = 0;
+		glGetQueryObjectui64v(queries[i], GL_QUERY_RESULT, &nanoseconds);
+		pending[i] = false;
+
+		totalMilliseconds += nanoseconds / 1000000.0;
+		sampleCount++;
+
+		// Print and start a fresh window once enough samples are collected
+		if (reportInterval != 0 && sampleCount >= reportInterval)
+		{
+			report();
+			reset();
+		}
+	}
+}
+
+double GpuBenchmark::getAverageMilliseconds()
+{
+	if (sampleCount == 0)
+	{
+		return 0.0;
+	}
+
+	return totalMilliseconds / sampleCount;
+}
+
+void GpuBenchmark::report()
+{
+	printf("[Benchmark] %s: %.4f ms avg GPU time over %u sample(s)\n", name.c_str(), getAverageMilliseconds(), sampleCount);
+}
+
+void GpuBenchmark::reset()
+{
+	sampleCount = 0;
+	totalMilliseconds = 0.0;
+}
+
+void GpuBenchmark::clear()
+{
+	if (queries[0] != 0)
+	{
+		glDeleteQueries(QUERY_COUNT, queries);
+	}
+
+	for (int i = 0; i < QUERY_COUNT; i++)
+	{
+		queries[i] = 0;
+		pending[i] = false;
+	}
+	nextQuery = 0;
+	running = false;
+}
+
+GpuBenchmark::~GpuBenchmark()
+{
+}
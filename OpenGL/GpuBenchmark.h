@@ -0,0 +1,44 @@
+#pragma once
+
+#include <string>
+
+#include <GL\glew.h>
+
+// Accumulates GPU timings for a named section of draw calls with GL_TIME_ELAPSED queries
+// and prints the average every reportEvery samples. Results are read back a few frames
+// later, so the CPU never waits for the GPU. Time elapsed queries can't overlap, so only
+// one GpuBenchmark may be between start and stop at a time.
+class GpuBenchmark
+{
+public:
+	GpuBenchmark();
+	GpuBenchmark(std::string benchName, unsigned int reportEvery);
+
+	void start();
+	void stop();
+
+	double getAverageMilliseconds();
+
+	void report();
+	void reset();
+
+	void clear();
+
+	~GpuBenchmark();
+
+private:
+	static const int QUERY_COUNT = 4;
+
+	std::string name;
+	unsigned int reportInterval;
+	unsigned int sampleCount;
+	double totalMilliseconds;
+
+	// Created on first use, since benchmarks are often made before the GL context
+	GLuint queries[QUERY_COUNT];
+	bool pending[QUERY_COUNT];
+	int nextQuery;
+	bool running;
+
+	void collectResults();
+};
@@ -0,0 +1,12 @@
+#include "Hash.h"
+
+uint64_t hashBytes(uint64_t hash, const void* bytes, size_t size)
+{
+	const unsigned char* data = (const unsigned char*)bytes;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= data[i];
+		hash *= 0x100000001B3ULL;
+	}
+	return hash;
+}
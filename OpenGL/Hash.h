@@ -0,0 +1,10 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// 64-bit FNV-1a, used to key the on-disk caches. Start from FNV_OFFSET_BASIS and
+// feed in each value with hashBytes.
+const uint64_t FNV_OFFSET_BASIS = 0xCBF29CE484222325ULL;
+
+uint64_t hashBytes(uint64_t hash, const void* bytes, size_t size);
@@ -0,0 +1,247 @@
+#include <thread>
+#include <cmath>
+
+// SSE2 is part of every x64 target, and of x86 builds with /arch:SSE2 or -msse2
+#if defined(_M_X64) || defined(__x86_64__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define HEIGHTMAP_GENERATOR_SSE2
+#include <emmintrin.h>
+#endif
+
+#include "HeightmapGenerator.h"
+#include "Mesh.h"
+
+// Signed 10-bit components: x in bits 0-9, y in 10-19, z in 20-29
+static GLuint packNormal(float x, float y, float z)
+{
+	GLuint packedX = (GLuint)lrintf(x * 511.0f) & 0x3FF;
+	GLuint packedY = (GLuint)lrintf(y * 511.0f) & 0x3FF;
+	GLuint packedZ = (GLuint)lrintf(z * 511.0f) & 0x3FF;
+	return packedX | packedY << 10 | packedZ << 20;
+}
+
+// The surface is y = f(x, z), so its normal is (-df/dx, 1, -df/dz) normalized
+static GLuint getGradientNormal(float dx, float dz)
+{
+	float length = std::sqrt(dx * dx + 1.0f + dz * dz);
+	return packNormal(-dx / length, 1.0f / length, -dz / length);
+}
+
+HeightmapGenerator::HeightmapGenerator()
+{
+	threadCount = std::thread::hardware_concurrency();
+
+	// hardware_concurrency is allowed to report 0 when it can't tell
+	if (threadCount == 0)
+	{
+		threadCount = 1;
+	}
+
+	simdEnabled = true;
+}
+
+HeightmapGenerator::HeightmapGenerator(unsigned int numThreads)
+{
+	threadCount = numThreads > 0 ? numThreads : 1;
+	simdEnabled = true;
+}
+
+void HeightmapGenerator::generateVertices(const unsigned char* data, int width, int height, int nChannels,
+	float yScale, float yShift, std::vector<float>& vertices)
+{
+	generateFromSamples(data, nChannels, 1.0f, width, height, yScale, yShift, vertices);
+}
+
+void HeightmapGenerator::generateVertices(const unsigned short* data, int width, int height, int nChannels,
+	float yScale, float yShift, std::vector<float>& vertices)
+{
+	// Keep heights in the same units as 8-bit maps, which stb widens to 16 bits as value * 257
+	generateFromSamples(data, nChannels, 257.0f, width, height, yScale, yShift, vertices);
+}
+
+void HeightmapGenerator::generateVertices(const float* samples, int width, int height,
+	float yScale, float yShift, std::vector<float>& vertices)
+{
+	generateFromSamples(samples, 1, 1.0f, width, height, yScale, yShift, vertices);
+}
+
+void HeightmapGenerator::generateIndices(int width, int height, std::vector<unsigned int>& indices)
+{
+	unsigned int numStrips = height - 1;
+	unsigned int stripLength = width * 2 + 1;
+
+	indices.resize((size_t)numStrips * stripLength);
+
+	// One strip per pair of rows, each followed by a restart index
+	forEachRowRange(numStrips, [&](unsigned int firstStrip, unsigned int lastStrip)
+	{
+		for (unsigned int i = firstStrip; i < lastStrip; i++)
+		{
+			unsigned int* out = &indices[(size_t)stripLength * i];
+
+			for (unsigned int j = 0; j < width; j++)
+			{
+				for (unsigned int k = 0; k < 2; k++)
+				{
+					*out++ = j + width * (i + k);
+				}
+			}
+
+			*out = HEIGHTMAP_RESTART_INDEX;
+		}
+	});
+}
+
+template <typename T>
+void HeightmapGenerator::generateFromSamples(const T* samples, size_t sampleStride, float sampleDivisor, int width, int height,
+	float yScale, float yShift, std::vector<float>& vertices)
+{
+	vertices.resize((size_t)width * height * 3);
+
+	forEachRowRange(height, [&](unsigned int firstRow, unsigned int lastRow)
+	{
+		for (unsigned int i = firstRow; i < lastRow; i++)
+		{
+			float* out = &vertices[(size_t)width * i * 3];
+
+			for (unsigned int j = 0; j < width; j++)
+			{
+				// Only the first channel of each texel holds height
+				float y = samples[(j + (size_t)width * i) * sampleStride] / sampleDivisor;
+
+				// Store transformed values for x, y, and z
+				*out++ = -height / 2.0f + height * i / (float)height;
+				*out++ = y * yScale - yShift;
+				*out++ = -width / 2.0f + width * j / (float)width;
+			}
+		}
+	});
+}
+
+void HeightmapGenerator::generateNormals(const float* heights, size_t heightStride, int width, int height, std::vector<GLuint>& normals)
+{
+	normals.resize((size_t)width * height);
+
+	forEachRowRange(height, [&](unsigned int firstRow, unsigned int lastRow)
+	{
+		for (unsigned int i = firstRow; i < lastRow; i++)
+		{
+			// Edge rows and columns fall back to one-sided differences
+			unsigned int rowAbove = i > 0 ? i - 1 : i;
+			unsigned int rowBelow = i + 1 < (unsigned int)height ? i + 1 : i;
+			float rowScale = rowBelow - rowAbove > 0 ? 1.0f / (rowBelow - rowAbove) : 0.0f;
+
+			const float* above = heights + (size_t)width * rowAbove * heightStride;
+			const float* below = heights + (size_t)width * rowBelow * heightStride;
+			const float* row = heights + (size_t)width * i * heightStride;
+			GLuint* out = &normals[(size_t)width * i];
+
+			auto scalarNormal = [&](unsigned int j)
+			{
+				unsigned int left = j > 0 ? j - 1 : j;
+				unsigned int right = j + 1 < (unsigned int)width ? j + 1 : j;
+				float colScale = right - left > 0 ? 1.0f / (right - left) : 0.0f;
+
+				float dx = (below[j * heightStride] - above[j * heightStride]) * rowScale;
+				float dz = (row[right * heightStride] - row[left * heightStride]) * colScale;
+				out[j] = getGradientNormal(dx, dz);
+			};
+
+			unsigned int j = 0;
+			scalarNormal(j++);
+
+#ifdef HEIGHTMAP_GENERATOR_SSE2
+			if (simdEnabled)
+			{
+				// Four interior columns at a time. Same operations in the same order as
+				// getGradientNormal, so both paths give the same packed result.
+				const __m128 rowScale4 = _mm_set1_ps(rowScale);
+				const __m128 half = _mm_set1_ps(0.5f);
+				const __m128 one = _mm_set1_ps(1.0f);
+				const __m128 zero = _mm_setzero_ps();
+				const __m128 unorm = _mm_set1_ps(511.0f);
+				const __m128i mask = _mm_set1_epi32(0x3FF);
+
+				auto load4 = [heightStride](const float* first)
+				{
+					if (heightStride == 1)
+					{
+						return _mm_loadu_ps(first);
+					}
+					return _mm_set_ps(first[heightStride * 3], first[heightStride * 2], first[heightStride], first[0]);
+				};
+
+				for (; j + 4 < (unsigned int)width; j += 4)
+				{
+					__m128 dx = _mm_mul_ps(_mm_sub_ps(load4(below + j * heightStride), load4(above + j * heightStride)), rowScale4);
+					__m128 dz = _mm_mul_ps(_mm_sub_ps(load4(row + (j + 1) * heightStride), load4(row + (j - 1) * heightStride)), half);
+
+					__m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), one), _mm_mul_ps(dz, dz)));
+					__m128 nx = _mm_div_ps(_mm_sub_ps(zero, dx), length);
+					__m128 ny = _mm_div_ps(one, length);
+					__m128 nz = _mm_div_ps(_mm_sub_ps(zero, dz), length);
+
+					__m128i packedX = _mm_and_si128(_mm_cvtps_epi32(_mm_mul_ps(nx, unorm)), mask);
+					__m128i packedY = _mm_and_si128(_mm_cvtps_epi32(_mm_mul_ps(ny, unorm)), mask);
+					__m128i packedZ = _mm_and_si128(_mm_cvtps_epi32(_mm_mul_ps(nz, unorm)), mask);
+					__m128i packed = _mm_or_si128(packedX, _mm_or_si128(_mm_slli_epi32(packedY, 10), _mm_slli_epi32(packedZ, 20)));
+
+					_mm_storeu_si128((__m128i*)(out + j), packed);
+				}
+			}
+#endif
+
+			for (; j < (unsigned int)width; j++)
+			{
+				scalarNormal(j);
+			}
+		}
+	});
+}
+
+unsigned int HeightmapGenerator::getThreadCount()
+{
+	return threadCount;
+}
+
+void HeightmapGenerator::setSimdEnabled(bool enabled)
+{
+	simdEnabled = enabled;
+}
+
+bool HeightmapGenerator::getSimdEnabled()
+{
+	return simdEnabled;
+}
+
+void HeightmapGenerator::forEachRowRange(unsigned int numRows, std::function<void(unsigned int, unsigned int)> job)
+{
+	unsigned int numWorkers = threadCount < numRows ? threadCount : numRows;
+
+	if (numWorkers <= 1)
+	{
+		job(0, numRows);
+		return;
+	}
+
+	// Each worker gets a contiguous block of rows, so no two threads write the same memory
+	std::vector<std::thread> workers;
+	unsigned int rowsPerWorker = numRows / numWorkers;
+	unsigned int extraRows = numRows % numWorkers;
+	unsigned int firstRow = 0;
+
+	for (unsigned int w = 0; w < numWorkers; w++)
+	{
+		unsigned int lastRow = firstRow + rowsPerWorker + (w < extraRows ? 1 : 0);
+		workers.push_back(std::thread(job, firstRow, lastRow));
+		firstRow = lastRow;
+	}
+
+	for (size_t w = 0; w < workers.size(); w++)
+	{
+		workers[w].join();
+	}
+}
+
+HeightmapGenerator::~HeightmapGenerator()
+{
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <vector>
+#include <functional>
+
+#include <GL\glew.h>
+
+// Builds heightmap vertex and index buffers.
+// Buffers are sized exactly up front and rows are split across worker threads.
+class HeightmapGenerator
+{
+public:
+	HeightmapGenerator();
+	HeightmapGenerator(unsigned int numThreads);
+
+	void generateVertices(const unsigned char* data, int width, int height, int nChannels,
+		float yScale, float yShift, std::vector<float>& vertices);
+	void generateVertices(const unsigned short* data, int width, int height, int nChannels,
+		float yScale, float yShift, std::vector<float>& vertices);
+	void generateVertices(const float* samples, int width, int height,
+		float yScale, float yShift, std::vector<float>& vertices);
+	void generateIndices(int width, int height, std::vector<unsigned int>& indices);
+
+	// Normals from central differences of a row-major height grid, one unit apart, packed for
+	// GL_INT_2_10_10_10_REV. heightStride is the distance between heights in floats, e.g. 3 for xyz vertices.
+	void generateNormals(const float* heights, size_t heightStride, int width, int height, std::vector<GLuint>& normals);
+
+	unsigned int getThreadCount();
+	void setSimdEnabled(bool enabled);
+	bool getSimdEnabled();
+
+	~HeightmapGenerator();
+
+private:
+	unsigned int threadCount;
+	bool simdEnabled;
+
+	// Heights are sample / sampleDivisor * yScale - yShift, reading every sampleStride-th value
+	template <typename T>
+	void generateFromSamples(const T* samples, size_t sampleStride, float sampleDivisor, int width, int height,
+		float yScale, float yShift, std::vector<float>& vertices);
+
+	void forEachRowRange(unsigned int numRows, std::function<void(unsigned int, unsigned int)> job);
+};
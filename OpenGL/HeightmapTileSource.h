@@ -0,0 +1,21 @@
+#pragma once
+
+#include <vector>
+
+// Somewhere heightmap samples can be read from a block at a time,
+// so terrain can be streamed in without loading the whole map
+class HeightmapTileSource
+{
+public:
+	virtual ~HeightmapTileSource() {}
+
+	// Reads the map's size. Cheap, called on the render thread.
+	virtual bool open() = 0;
+	virtual int getWidth() = 0;
+	virtual int getHeight() = 0;
+
+	// Copies a block of height samples, row by row, in 8-bit units (16-bit maps give fractions).
+	// Called on the loader thread.
+	virtual bool readRegion(unsigned int firstRow, unsigned int firstCol, unsigned int numRows, unsigned int numCols,
+		std::vector<float>& samples) = 0;
+};
@@ -0,0 +1,162 @@
+#include <stdio.h>
+
+#include "IndirectDrawList.h"
+#include "Mesh.h"
+
+IndirectDrawList::IndirectDrawList()
+{
+	commandCount = 0;
+	commandBuffer = 0;
+	drawDataBuffer = 0;
+	drawDataTexture = 0;
+}
+
+bool IndirectDrawList::isSupported()
+{
+	return (GLEW_VERSION_4_3 || GLEW_ARB_multi_draw_indirect) &&
+		(GLEW_VERSION_4_6 || GLEW_ARB_shader_draw_parameters);
+}
+
+void IndirectDrawList::begin()
+{
+	// Batches are kept so their vectors hold on to their capacity between frames
+	for (size_t i = 0; i < batches.size(); i++)
+	{
+		batches[i].commands.clear();
+		batches[i].drawData.clear();
+	}
+
+	commandCount = 0;
+}
+
+void IndirectDrawList::addDraw(GeometryArena* arena, int block, GLenum mode, const DrawElementsIndirectCommand& command,
+	const IndirectDrawData& data)
+{
+	IndirectBatch* batch = nullptr;
+
+	for (size_t i = 0; i < batches.size(); i++)
+	{
+		if (batches[i].arena == arena && batches[i].block == block && batches[i].mode == mode)
+		{
+			batch = &batches[i];
+			break;
+		}
+	}
+
+	if (!batch)
+	{
+		batches.push_back(IndirectBatch());
+		batch = &batches.back();
+		batch->arena = arena;
+		batch->block = block;
+		batch->mode = mode;
+	}
+
+	batch->commands.push_back(command);
+	batch->drawData.push_back(data);
+	commandCount++;
+}
+
+void IndirectDrawList::submit(GLuint indirectLocation, GLuint drawDataOffsetLocation)
+{
+	if (commandCount == 0)
+	{
+		return;
+	}
+
+	if (commandBuffer == 0)
+	{
+		glGenBuffers(1, &commandBuffer);
+		glGenBuffers(1, &drawDataBuffer);
+		glGenTextures(1, &drawDataTexture);
+	}
+
+	uploadCommands.clear();
+	uploadDrawData.clear();
+	for (size_t i = 0; i < batches.size(); i++)
+	{
+		uploadCommands.insert(uploadCommands.end(), batches[i].commands.begin(), batches[i].commands.end());
+		uploadDrawData.insert(uploadDrawData.end(), batches[i].drawData.begin(), batches[i].drawData.end());
+	}
+
+	// Respecified every frame so the driver can orphan last frame's storage
+	GLStateCache::bindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+	glBufferData(GL_DRAW_INDIRECT_BUFFER, uploadCommands.size() * sizeof(DrawElementsIndirectCommand), &uploadCommands[0], GL_STREAM_DRAW);
+
+	GLStateCache::bindBuffer(GL_TEXTURE_BUFFER, drawDataBuffer);
+	glBufferData(GL_TEXTURE_BUFFER, uploadDrawData.size() * sizeof(IndirectDrawData), &uploadDrawData[0], GL_STREAM_DRAW);
+
+	GLStateCache::bindTexture(INDIRECT_DRAW_DATA_UNIT, GL_TEXTURE_BUFFER, drawDataTexture);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, drawDataBuffer);
+
+	glUniform1i(indirectLocation, 1);
+
+	// Terrain strips end in a restart index, which never appears in triangle lists
+	glEnable(GL_PRIMITIVE_RESTART);
+	glPrimitiveRestartIndex(HEIGHTMAP_RESTART_INDEX);
+
+	size_t firstCommand = 0;
+	for (size_t i = 0; i < batches.size(); i++)
+	{
+		IndirectBatch& batch = batches[i];
+		if (batch.commands.empty())
+		{
+			continue;
+		}
+
+		// gl_DrawID restarts at 0 for every call, so the shader is told where this batch's data starts
+		glUniform1i(drawDataOffsetLocation, (GLint)firstCommand);
+
+		batch.arena->bind(batch.block);
+		glMultiDrawElementsIndirect(batch.mode, GL_UNSIGNED_INT,
+			(void*)(firstCommand * sizeof(DrawElementsIndirectCommand)), (GLsizei)batch.commands.size(), 0);
+
+		firstCommand += batch.commands.size();
+	}
+
+	glDisable(GL_PRIMITIVE_RESTART);
+	glUniform1i(indirectLocation, 0);
+}
+
+unsigned int IndirectDrawList::getCommandCount()
+{
+	return commandCount;
+}
+
+unsigned int IndirectDrawList::getBatchCount()
+{
+	unsigned int count = 0;
+	for (size_t i = 0; i < batches.size(); i++)
+	{
+		if (!batches[i].commands.empty())
+		{
+			count++;
+		}
+	}
+
+	return count;
+}
+
+void IndirectDrawList::clear()
+{
+	batches.clear();
+	commandCount = 0;
+
+	if (commandBuffer != 0)
+	{
+		glDeleteBuffers(1, &commandBuffer);
+		glDeleteBuffers(1, &drawDataBuffer);
+		glDeleteTextures(1, &drawDataTexture);
+		GLStateCache::forgetBuffer(commandBuffer);
+		GLStateCache::forgetBuffer(drawDataBuffer);
+		GLStateCache::forgetTexture(drawDataTexture);
+		commandBuffer = 0;
+		drawDataBuffer = 0;
+		drawDataTexture = 0;
+	}
+}
+
+IndirectDrawList::~IndirectDrawList()
+{
+	clear();
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <vector>
+
+#include <GL\glew.h>
+
+#include <glm\glm.hpp>
+
+#include "GeometryArena.h"
+#include "GLStateCache.h"
+
+// Texture unit the draw data buffer is bound to. Unit 0 is the material texture.
+// Shader points every program's drawData sampler here when it links.
+const GLuint INDIRECT_DRAW_DATA_UNIT = 1;
+
+// Texels of per-draw data the vertex shader reads for each command (see IndirectDrawData)
+const int INDIRECT_DRAW_DATA_TEXELS = 6;
+
+// Layout glMultiDrawElementsIndirect reads from the draw indirect buffer
+struct DrawElementsIndirectCommand
+{
+	GLuint count;
+	GLuint instanceCount;
+	GLuint firstIndex;
+	GLint baseVertex;
+	GLuint baseInstance;
+};
+
+// What the shader would otherwise get from per-draw uniforms, fetched with gl_DrawID.
+// grid is the terrainGrid of a chunk (all 0 for meshes).
+// lod is (lodLevel, morph start, morph end, material index), material -1 for the plain material.
+struct IndirectDrawData
+{
+	glm::mat4 model;
+	glm::vec4 grid;
+	glm::vec4 lod;
+};
+
+// Collects a frame's draws and submits them with one glMultiDrawElementsIndirect per
+// arena block and primitive type, instead of one draw call per object.
+// Needs ARB_multi_draw_indirect and ARB_shader_draw_parameters; check isSupported first.
+class IndirectDrawList
+{
+public:
+	IndirectDrawList();
+
+	static bool isSupported();
+
+	// Clears the previous frame's draws
+	void begin();
+	void addDraw(GeometryArena* arena, int block, GLenum mode, const DrawElementsIndirectCommand& command,
+		const IndirectDrawData& data);
+	// Uploads the commands and draw data and issues the batches.
+	// indirectLocation and drawDataOffsetLocation are the shader's indirect and drawDataOffset uniforms.
+	void submit(GLuint indirectLocation, GLuint drawDataOffsetLocation);
+
+	unsigned int getCommandCount();
+	unsigned int getBatchCount();
+
+	void clear();
+
+	~IndirectDrawList();
+
+private:
+	// Draws sharing a VAO and primitive type
+	struct IndirectBatch
+	{
+		GeometryArena* arena;
+		int block;
+		GLenum mode;
+		std::vector<DrawElementsIndirectCommand> commands;
+		std::vector<IndirectDrawData> drawData;
+	};
+
+	std::vector<IndirectBatch> batches;
+	unsigned int commandCount;
+
+	// Every batch's commands and draw data back to back, refilled each frame
+	std::vector<DrawElementsIndirectCommand> uploadCommands;
+	std::vector<IndirectDrawData> uploadDrawData;
+
+	GLuint commandBuffer, drawDataBuffer, drawDataTexture;
+};
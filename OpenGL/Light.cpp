@@ -20,14 +20,10 @@ Light::Light(GLfloat red, GLfloat green, GLfloat blue, GLfloat aIntensity,
 	diffuseIntensity = dIntensity;
 }
 
-void Light::UseLight(GLfloat ambientIntensityLocation, GLfloat ambientColourLocation, 
-	GLfloat diffuseIntensityLocation, GLfloat directionLocation)
+void Light::UseLight(SceneUniforms& sceneUniforms)
 {
-	glUniform3f(ambientColourLocation, colour.x, colour.y, colour.z);
-	glUniform1f(ambientIntensityLocation, ambientIntensity);
-
-	glUniform3f(directionLocation, direction.x, direction.y, direction.z);
-	glUniform1f(diffuseIntensityLocation, diffuseIntensity);
+	sceneUniforms.lightColour = glm::vec4(colour, ambientIntensity);
+	sceneUniforms.lightDirection = glm::vec4(direction, diffuseIntensity);
 }
 
 Light::~Light()
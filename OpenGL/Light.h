@@ -3,6 +3,8 @@
 #include <GL\glew.h>
 #include <glm\glm.hpp>
 
+#include "UniformBuffer.h"
+
 class Light
 {
 	public:
@@ -10,8 +12,8 @@ class Light
 		Light(GLfloat red, GLfloat green, GLfloat blue, GLfloat aIntensity,
 			GLfloat xDir, GLfloat yDir, GLfloat zDir, GLfloat dIntensity); //aIntensity = ambientIntensity, dIntensity = diffuseIntensity
 
-		void UseLight(GLfloat ambientIntensityLocation, GLfloat ambientColourLocation,
-			GLfloat diffuseIntensityLocation, GLfloat directionLocation);
+		// Writes the light into the scene block's data; upload it with the scene UniformBuffer
+		void UseLight(SceneUniforms& sceneUniforms);
 
 		~Light();
 
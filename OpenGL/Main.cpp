@@ -2,6 +2,7 @@
 
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <cmath>
 #include <vector>
 
@@ -11,14 +12,32 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <glm/gtc/matrix_inverse.hpp>
 
 #include "Window.h"
 #include "Mesh.h"
+#include "IndirectDrawList.h"
+#include "RenderQueue.h"
 #include "Shader.h"
+#include "ShaderCache.h"
+#include "GLStateCache.h"
 #include "Camera.h"
+#include "Transform.h"
+#include "EntityStore.h"
+#include "TransformKernel.h"
 #include "Texture.h"
+#include "AssetLoader.h"
 #include "Light.h"
+#include "UniformBuffer.h"
 #include "Material.h"
+#include "Benchmark.h"
+#include "GpuBenchmark.h"
+#include "HeightmapGenerator.h"
+#include "TerrainQuadtree.h"
+#include "TerrainStreamer.h"
+#include "PngTileSource.h"
+#include "TiledHeightmap.h"
+#include "TerrainBakeCache.h"
 #include "Main.h"
 
 const float degreeToRadians = 3.14159265f / 180.0f;
@@ -28,20 +47,102 @@ Camera camera;
 double xPos, yPos, prevXPos, prevYPos;
 GLfloat moveSpeed = 5.0f;
 GLfloat turnSpeed = 0.1f;
+GLfloat fieldOfView = 45.0f;
+const GLfloat farPlane = 100.0f;
 glm::mat4 projection;
 
 // Textures
 Texture brickTexture;
 Texture dirtTexture;
+AssetLoader assetLoader;
+const unsigned int assetLoaderThreads = 2;
+const size_t textureUploadBudget = 4 * 1024 * 1024;
 
 // Heightmaps
+static const char* heightmapFile = "Heightmaps/custom_heightmap_2.png";
+static const char* heightmapFiles[] =
+{
+    "Heightmaps/custom_heightmap.png",
+    "Heightmaps/custom_heightmap_2.png",
+    "Heightmaps/iceland_heightmap.png"
+};
+// Samples per tile edge in converted .hmt files
+const unsigned int heightmapFileTileSize = 64;
+const float heightmapYScale = 0.25f;
+const float heightmapYShift = 16.0f;
+
+HeightmapGenerator heightmapGenerator;
+bool useTerrainBake = true;
 std::vector<float> heightmapVertices;
-std::vector<unsigned int> heightmapIndices;
-unsigned char* heightmapData;
+std::vector<GLuint> heightmapNormals;
+unsigned short* heightmapData;
 
 int width, height, nChannels;
-unsigned int NUM_STRIPS;
-unsigned int NUM_VERTS_PER_STRIP;
+
+// Terrain chunks (quads per side), level of detail and per-frame stats
+const unsigned int terrainChunkSize = 64;
+const GLfloat terrainLodPixelTolerance = 2.0f;
+TerrainQuadtree terrainQuadtree;
+GLfloat terrainLodToggleTime = 0.0f;
+unsigned int lastVisibleChunks = 0;
+unsigned int lastCulledChunks = 0;
+unsigned int lastDrawnVertices = 0;
+
+// Terrain streaming (--stream-terrain), for maps too big to keep in memory
+bool streamTerrain = false;
+size_t terrainStreamBudgetMB = 256;
+const unsigned int terrainTileSize = 64;
+const unsigned int terrainStreamRadius = 6;
+const unsigned int terrainUploadsPerFrame = 2;
+HeightmapTileSource* terrainTileSource = nullptr;
+TerrainStreamer terrainStreamer;
+GLfloat lastStreamReportTime = 0.0f;
+
+// Terrain draw mode (T toggles between them)
+TerrainDrawMode terrainDrawMode = TERRAIN_DRAW_PRIMITIVE_RESTART;
+GLfloat terrainToggleTime = 0.0f;
+Benchmark terrainSubmitBenchmarks[2] =
+{
+    Benchmark("Terrain submit (per strip)", 500),
+    Benchmark("Terrain submit (primitive restart)", 500)
+};
+
+// Vertex shader matrices (M toggles). Normally MVP and the normal matrix are worked out once
+// per object on the CPU; per vertex builds them in the shader, the way it used to, for comparison.
+// Terrain GPU time is reported for each, turn LOD off with Y to time the full resolution terrain.
+bool perVertexMatrices = false;
+GLfloat matrixToggleTime = 0.0f;
+GpuBenchmark terrainGpuBenchmarks[2] =
+{
+    GpuBenchmark("Terrain GPU (matrices per object)", 500),
+    GpuBenchmark("Terrain GPU (matrices per vertex)", 500)
+};
+
+// Redundant bind and render queue state change stats (--report-gl-state), printed every 5 seconds
+bool reportGLState = false;
+GLfloat lastGLStateReportTime = 0.0f;
+
+// Multi-draw-indirect submission (--indirect-draws). Terrain chunks and per mesh stress
+// copies are queued during the frame and drawn with one call per arena block and primitive.
+bool useIndirectDraws = false;
+IndirectDrawList indirectDraws;
+Benchmark indirectSubmitBenchmark("Scene submit (multi-draw indirect)", 500);
+
+// Instancing stress scene (--instancing-stress N): N copies of the first cube.
+// N toggles between one instanced draw and one draw per copy (or one indirect submission
+// with --indirect-draws). No path frustum culls the copies, so all three draw the same work.
+unsigned int instancingStressCount = 0;
+bool useInstancing = true;
+GLfloat instancingToggleTime = 0.0f;
+std::vector<MeshInstance> stressInstances;
+EntityStore stressEntities;
+enum StressDrawMode {STRESS_PER_MESH, STRESS_INSTANCED, STRESS_INDIRECT};
+Benchmark stressFrameBenchmarks[3] =
+{
+    Benchmark("Stress frame (per mesh, unculled)", 500),
+    Benchmark("Stress frame (instanced, unculled)", 500),
+    Benchmark("Stress frame (indirect, unculled)", 500)
+};
 
 // Materials
 Material shinyMaterial;
@@ -50,6 +151,12 @@ Material dullMaterial;
 // Lighting
 Light mainLight;
 
+// Shared uniform blocks: camera data every frame, lighting when it changes
+UniformBuffer frameUniformBuffer;
+UniformBuffer sceneUniformBuffer;
+FrameUniforms frameUniforms;
+SceneUniforms sceneUniforms;
+
 // Time
 GLfloat deltaTime = 0.0f;
 GLfloat lastTime = 0.0f;
@@ -70,27 +177,35 @@ float maxSize = 0.8f;
 float minSize = 0.1f;
 
 // Models
+// The terrain is drawn through terrainQuadtree, everything else is an entity in sceneEntities
+const size_t staticGeometryBlockVertices = 65536;
+const size_t staticGeometryBlockIndices = 262144;
+GeometryArena staticGeometry(GEOMETRY_FORMAT_MESH, staticGeometryBlockVertices, staticGeometryBlockIndices);
 std::vector<Mesh*> meshList;
-std::vector<glm::mat4> modelList;
-std::vector<GLuint> uniformModelList;
-GLuint uniformProjection;
-GLuint uniformView;
-GLuint uniformEyePosition;
-std::vector<GLuint> uniformAmbientIntensityList;
-std::vector<GLuint> uniformAmbientColourList;
-std::vector<GLuint> uniformDirectionList;
-std::vector<GLuint> uniformDiffuseIntensityList;
-std::vector<GLuint> uniformSpecularIntensityList;
-std::vector<GLuint> uniformShininessList;
-
-glm::vec3 position = glm::vec3(0.0f);
-glm::vec3 scale = glm::vec3(1.0f);
-glm::vec3 rotation = glm::vec3(0.0f);
-
-// Shaders
+Transform terrainTransform;
+EntityStore sceneEntities;
+
+// Scene meshes are drawn through a queue sorted by shader, texture and material
+RenderQueue renderQueue;
+
+// Where the scene objects are placed, every object's own transform is applied on top
+Transform sceneObjectPlacement(glm::vec3(0.0f, 0.0f, -3.0f), glm::vec3(0.0f, 2.0f, 0.0f), glm::vec3(0.3f, 0.3f, 0.3f));
+
+// Shaders. Every program is a permutation of the same source, compiled only when it's first used.
 static const char* vShader = "Shaders/shader.vert";
 static const char* fShader = "Shaders/shader.frag";
-std::vector<Shader*> shaderList;
+ShaderCache shaderCache(vShader, fShader);
+Shader* terrainShader = nullptr;  // grid reconstruction and LOD morphing, ambient and diffuse
+Shader* meshShader = nullptr;     // textured, lit and specular scene meshes
+Shader* indirectShader = nullptr; // terrain and meshes together in one indirect submission
+
+// Linked programs are saved as .programbin files beside the shaders (--no-shader-cache turns this off)
+bool useShaderBinaries = true;
+Benchmark shaderStartupBenchmark("Shader startup", 0);
+double shaderSubmitMilliseconds = 0.0;
+
+// Shader files are checked for changes once a second
+GLfloat lastShaderCheckTime = 0.0f;
 
 // Window properties
 Window mainWindow;
@@ -99,61 +214,117 @@ int screenHeight = 600;
 
 void loadTextures()
 {
+    // Decoded in the background and uploaded over the first few frames
+    assetLoader.start(assetLoaderThreads, textureUploadBudget);
+
     brickTexture = Texture((char*)"Textures/brick.png");
-    brickTexture.LoadTexture();
+    assetLoader.loadTexture(&brickTexture);
 
     dirtTexture = Texture((char*)"Textures/dirt.png");
-    dirtTexture.LoadTexture();
+    assetLoader.loadTexture(&dirtTexture);
 }
 
 void generateHeightmapVertices()
 {
-    float yScale = 0.25f;
-    float yShift = 16.0f;
+    heightmapGenerator.generateVertices(heightmapData, width, height, nChannels,
+        heightmapYScale, heightmapYShift, heightmapVertices);
+
+    // Release heightmap data from memory
+    stbi_image_free(heightmapData);
+}
+
+void generateHeightmapNormals()
+{
+    // Heights are every third float of the xyz vertices
+    heightmapGenerator.generateNormals(&heightmapVertices[1], 3, width, height, heightmapNormals);
+}
 
-    // Loop through the heightmap's texels
-    for (unsigned int i = 0; i < height; i++)
+bool isTiledHeightmap(const char* fileLoc)
+{
+    size_t length = strlen(fileLoc);
+    return length >= 4 && strcmp(fileLoc + length - 4, ".hmt") == 0;
+}
+
+// Swaps the extension of a heightmap path, e.g. for its .hmt or .terrainbake file
+std::string getPathWithExtension(const char* fileLoc, const char* extension)
+{
+    std::string path = fileLoc;
+    size_t dot = path.find_last_of('.');
+
+    if (dot != std::string::npos && path.find_first_of("/\\", dot) == std::string::npos)
     {
-        for (unsigned int j = 0; j < width; j++)
-        {
-            // Access each texel individually
-            unsigned char* texel = heightmapData + (j + width * i) * nChannels;
+        path.erase(dot);
+    }
 
-            // Height value for texel
-            unsigned char y = texel[0];
+    return path + extension;
+}
 
-            // Store transformed values for x, y, and z
-            heightmapVertices.push_back(-height / 2.0f + height * i / (float)height);
-            heightmapVertices.push_back(y * yScale - yShift);
-            heightmapVertices.push_back(-width / 2.0f + width * j / (float)width);
-        }
+// Converts an image heightmap into a tiled .hmt file, keeping 16-bit precision where the source has it
+bool convertHeightmap(const char* inputLoc, const char* outputLoc)
+{
+    int mapWidth, mapHeight, mapChannels;
+
+    // 8-bit images are widened to 16 bits as value * 257
+    unsigned short* data = stbi_load_16(inputLoc, &mapWidth, &mapHeight, &mapChannels, 0);
+    if (!data)
+    {
+        printf("Failed to load %s\n", inputLoc);
+        return false;
     }
 
-    NUM_STRIPS = height - 1;
-    NUM_VERTS_PER_STRIP = width * 2;
+    // Only the first channel holds height
+    std::vector<uint16_t> samples((size_t)mapWidth * mapHeight);
+    for (size_t i = 0; i < samples.size(); i++)
+    {
+        samples[i] = data[i * mapChannels];
+    }
 
-    // Release heightmap data from memory
-    stbi_image_free(heightmapData);
+    stbi_image_free(data);
+
+    if (!TiledHeightmap::write(outputLoc, &samples[0], mapWidth, mapHeight, heightmapFileTileSize))
+    {
+        return false;
+    }
+
+    printf("Converted %s (%d x %d) -> %s\n", inputLoc, mapHeight, mapWidth, outputLoc);
+    return true;
 }
 
-void generateHeightmapIndices()
+void convertAllHeightmaps()
 {
-    for (unsigned int i = 0; i < height; i++)
+    for (size_t i = 0; i < sizeof(heightmapFiles) / sizeof(heightmapFiles[0]); i++)
     {
-        for (unsigned int j = 0; j < width; j++)
-        {
-            for (unsigned int k = 0; k < 2; k++)
-            {
-                heightmapIndices.push_back(j + width * (i + k));
-            }
-        }
+        convertHeightmap(heightmapFiles[i], getPathWithExtension(heightmapFiles[i], ".hmt").c_str());
     }
 }
 
-void createHeightMap()
+// Fills heightmapVertices from either a tiled .hmt file or an image
+bool loadHeightmapVertices()
 {
+    // Tiled heightmaps are mapped straight from disk, skipping the PNG decode
+    if (isTiledHeightmap(heightmapFile))
+    {
+        TiledHeightmap tiledHeightmap(heightmapFile);
+        std::vector<float> samples;
+
+        if (!tiledHeightmap.open() ||
+            !tiledHeightmap.readRegion(0, 0, tiledHeightmap.getHeight(), tiledHeightmap.getWidth(), samples))
+        {
+            std::cout << "Failed to load heightmap" << std::endl;
+            return false;
+        }
+
+        width = tiledHeightmap.getWidth();
+        height = tiledHeightmap.getHeight();
+        std::cout << "Loaded heightmap of size " << height << " x " << width << std::endl;
+
+        heightmapGenerator.generateVertices(&samples[0], width, height, heightmapYScale, heightmapYShift, heightmapVertices);
+        return true;
+    }
+
     // Load heightmap from memory
-    heightmapData = stbi_load("Heightmaps/custom_heightmap_2.png", &width, &height, &nChannels, 0);
+    // Load at 16 bits so 16-bit maps keep their precision. 8-bit maps come back as value * 257.
+    heightmapData = stbi_load_16(heightmapFile, &width, &height, &nChannels, 0);
 
     // Check if the heightmap has loaded correctly
     if (heightmapData)
@@ -163,20 +334,63 @@ void createHeightMap()
     else
     {
         std::cout << "Failed to load texture" << std::endl;
+        return false;
     }
 
     // Initialise all necessary heightmap details
     generateHeightmapVertices();
-    generateHeightmapIndices();
+    return true;
+}
+
+void createHeightMap()
+{
+
+    // Streamed tiles are loaded in the background once the render loop starts
+    if (streamTerrain)
+    {
+        if (isTiledHeightmap(heightmapFile))
+        {
+            terrainTileSource = new TiledHeightmap(heightmapFile);
+        }
+        else
+        {
+            terrainTileSource = new PngTileSource(heightmapFile);
+        }
+
+        terrainStreamer.start(terrainTileSource, terrainTileSize, terrainStreamBudgetMB * 1024 * 1024,
+            terrainStreamRadius, heightmapYScale, heightmapYShift);
+        return;
+    }
 
-    // Create heightmap mesh
-    Mesh* heightmapMesh = new Mesh();
-    heightmapMesh->createMeshFromHeightmap(heightmapVertices, heightmapIndices);
-    meshList.push_back(heightmapMesh);
+    Benchmark startupBenchmark("Terrain startup", 0);
+    startupBenchmark.start();
 
-    // Create heightmap model
-    glm::mat4 heightmapModel = glm::mat4(1.0f);
-    modelList.push_back(heightmapModel);
+    // A bake from an earlier run with the same heightmap and parameters skips decoding and generation
+    std::string bakeFile = getPathWithExtension(heightmapFile, ".terrainbake");
+    uint64_t bakeKey = useTerrainBake ? TerrainBakeCache::computeKey(heightmapFile, heightmapYScale, heightmapYShift, terrainChunkSize) : 0;
+    TerrainBakeCache bake(bakeFile.c_str(), bakeKey);
+
+    if (bakeKey != 0 && bake.open() && terrainQuadtree.build(bake))
+    {
+        startupBenchmark.stop();
+        printf("Terrain startup (warm, from %s): %.2f ms\n", bakeFile.c_str(), startupBenchmark.getLastMilliseconds());
+        return;
+    }
+    bake.close();
+
+    if (!loadHeightmapVertices())
+    {
+        return;
+    }
+    generateHeightmapNormals();
+
+    // Split the heightmap into culled chunks, baking them for next time
+    terrainQuadtree.build(heightmapVertices, heightmapNormals, width, height, terrainChunkSize,
+        TerrainChunkBuilder::getHeightmapQuantization(width, height, heightmapYScale, heightmapYShift),
+        bakeKey != 0 ? &bake : nullptr);
+
+    startupBenchmark.stop();
+    printf("Terrain startup (cold): %.2f ms\n", startupBenchmark.getLastMilliseconds());
 }
 
 void calcAverageNormals(unsigned int* indices, unsigned int indexCount, GLfloat* vertices,
@@ -219,7 +433,8 @@ void calcAverageNormals(unsigned int* indices, unsigned int indexCount, GLfloat*
     }
 }
 
-void createSpecifiedObject(int type, GLfloat vertices[], unsigned int indices[], unsigned int numVertices, unsigned int numIndices)
+void createSpecifiedObject(int type, GLfloat vertices[], unsigned int indices[], unsigned int numVertices, unsigned int numIndices,
+    Texture* texture, Material* material)
 {
     if (type == 0) {
         calcAverageNormals(indices, 12, vertices, 36, 8, 5);
@@ -228,16 +443,27 @@ void createSpecifiedObject(int type, GLfloat vertices[], unsigned int indices[],
         calcAverageNormals(indices, 36, vertices, 64, 8, 5);
     }
 
-    Mesh* mesh = new Mesh();
+    Mesh* mesh = new Mesh(&staticGeometry);
     mesh->createMesh(vertices, indices, numVertices, numIndices);
     meshList.push_back(mesh);
 
-    glm::mat4 model = glm::mat4(1.0f);
-    modelList.push_back(model);
+    // numVertices counts floats, 8 to a vertex with the position first
+    glm::vec3 boundsMin(vertices[0], vertices[1], vertices[2]);
+    glm::vec3 boundsMax = boundsMin;
+    for (unsigned int v = 0; v < numVertices; v += 8)
+    {
+        glm::vec3 vertex(vertices[v], vertices[v + 1], vertices[v + 2]);
+        boundsMin = glm::min(boundsMin, vertex);
+        boundsMax = glm::max(boundsMax, vertex);
+    }
+
+    sceneEntities.createEntity(mesh, texture, material, boundsMin, boundsMax);
 }
 
 void createObjects()
 {
+    sceneEntities.setParent(&sceneObjectPlacement);
+
     #pragma region Model Indices
     unsigned int indices[] =
     {
@@ -319,139 +545,643 @@ void createObjects()
     #pragma endregion
 
     // Pyramids
-    createSpecifiedObject(0, vertices, indices, 32, 12);
+    createSpecifiedObject(0, vertices, indices, 32, 12, &brickTexture, &shinyMaterial);
 
     // Cubes
-    createSpecifiedObject(1, vertices2, indices2, 64, 36);
-    createSpecifiedObject(1, vertices3, indices2, 64, 36);
+    createSpecifiedObject(1, vertices2, indices2, 64, 36, &dirtTexture, &shinyMaterial);
+    createSpecifiedObject(1, vertices3, indices2, 64, 36, &dirtTexture, &dullMaterial);
+}
+
+// Lays the stress copies out on a square grid above the terrain, alternating materials
+void createInstancingStressScene()
+{
+    unsigned int gridSize = (unsigned int)ceil(sqrt((double)instancingStressCount));
+    GLfloat spacing = 2.5f;
+
+    // The copies share the first cube's mesh and bounds
+    glm::vec3 boundsMin = sceneEntities.getLocalBoundsMin(1);
+    glm::vec3 boundsMax = sceneEntities.getLocalBoundsMax(1);
+
+    for (unsigned int i = 0; i < instancingStressCount; i++)
+    {
+        GLfloat x = ((i % gridSize) - gridSize * 0.5f) * spacing;
+        GLfloat z = ((i / gridSize) - gridSize * 0.5f) * spacing;
+
+        Material* material = i % 2 == 0 ? &shinyMaterial : &dullMaterial;
+        Entity entity = stressEntities.createEntity(meshList[1], &dirtTexture, material, boundsMin, boundsMax);
+        stressEntities.setPosition(entity, glm::vec3(x, 10.0f, z));
+        stressEntities.setScale(entity, glm::vec3(0.3f, 0.3f, 0.3f));
+    }
+
+    stressEntities.updateTransforms();
+
+    stressInstances.resize(instancingStressCount);
+    for (unsigned int i = 0; i < instancingStressCount; i++)
+    {
+        stressInstances[i].model = stressEntities.getWorldMatrix(i);
+        stressInstances[i].material = i % 2;
+    }
+
+    // The copies don't move, so the instance buffer is only filled once
+    meshList[1]->setInstances(stressInstances);
+
+    printf("Instancing stress scene: %u cubes\n", instancingStressCount);
+}
+
+// Starts every program the scene needs. They compile on the driver's threads while the
+// terrain and objects are built, and finishShaders picks them up afterwards.
+void requestShaders()
+{
+    shaderStartupBenchmark.start();
+
+    Shader::enableParallelCompile();
+    shaderCache.setBinaryCacheEnabled(useShaderBinaries);
+
+    terrainShader = shaderCache.requestShader(SHADER_TERRAIN | SHADER_LIT);
+    meshShader = shaderCache.requestShader(SHADER_TEXTURED | SHADER_LIT | SHADER_SPECULAR);
+
+    // Terrain chunks and stress copies share draws, so this one needs terrain, materials and the texture
+    if (useIndirectDraws)
+    {
+        indirectShader = shaderCache.requestShader(SHADER_TEXTURED | SHADER_TERRAIN | SHADER_LIT | SHADER_SPECULAR);
+    }
+
+    shaderStartupBenchmark.stop();
+    shaderSubmitMilliseconds = shaderStartupBenchmark.getLastMilliseconds();
+}
+
+void finishShaders()
+{
+    // Only waits if the driver is still compiling or doesn't compile in the background
+    shaderStartupBenchmark.start();
+    shaderCache.finishAll();
+    shaderStartupBenchmark.stop();
+
+    // Time the main thread spent on shaders, the rest overlapped with building the scene
+    unsigned int fromBinaries = shaderCache.getBinaryLoadCount();
+    unsigned int programCount = shaderCache.getCompiledCount();
+    printf("Shader startup (%s, %u of %u programs from binaries): %.2f ms submitting, %.2f ms waiting\n",
+        fromBinaries == programCount ? "warm" : (fromBinaries == 0 ? "cold" : "partly warm"),
+        fromBinaries, programCount, shaderSubmitMilliseconds, shaderStartupBenchmark.getLastMilliseconds());
+}
+
+// Edited shaders are rebuilt in the background and swapped in once the driver has finished them
+void reloadShaders()
+{
+    GLfloat now = glfwGetTime();
+
+    if (now - lastShaderCheckTime >= 1.0f)
+    {
+        shaderCache.checkForChanges();
+        lastShaderCheckTime = now;
+    }
+
+    shaderCache.update();
+}
+
+void toggleTerrainDrawMode()
+{
+    terrainToggleTime += deltaTime;
+
+    if (mainWindow.getKeys()[GLFW_KEY_T] && terrainToggleTime >= 0.25f)
+    {
+        terrainToggleTime = 0.0f;
+
+        if (terrainDrawMode == TERRAIN_DRAW_PER_STRIP)
+        {
+            terrainDrawMode = TERRAIN_DRAW_PRIMITIVE_RESTART;
+            printf("Terrain draw mode: primitive restart (1 draw call per chunk)\n");
+        }
+        else
+        {
+            terrainDrawMode = TERRAIN_DRAW_PER_STRIP;
+            printf("Terrain draw mode: per strip (1 draw call per strip)\n");
+        }
+    }
 }
 
-void createShaders()
+void toggleInstancing()
 {
-    Shader* shader = new Shader();
-    shader->CreateFromFiles(vShader, fShader);
-    shaderList.push_back(shader);
+    instancingToggleTime += deltaTime;
+
+    if (mainWindow.getKeys()[GLFW_KEY_N] && instancingToggleTime >= 0.25f)
+    {
+        instancingToggleTime = 0.0f;
+
+        useInstancing = !useInstancing;
+        printf("Stress scene: %s\n", useInstancing ? "instanced (1 draw call)" :
+            useIndirectDraws ? "indirect (1 command per cube)" : "per mesh (1 draw call per cube)");
+    }
 }
 
-void initialiseUniforms()
+void toggleMatrixMode()
 {
-    for (size_t i = 0; i < modelList.size(); i++)
+    matrixToggleTime += deltaTime;
+
+    if (mainWindow.getKeys()[GLFW_KEY_M] && matrixToggleTime >= 0.25f)
     {
-        uniformModelList.push_back(0);
-        uniformProjection = 0;
-        uniformView = 0;
-        uniformEyePosition = 0;
+        matrixToggleTime = 0.0f;
 
-        uniformAmbientIntensityList.push_back(0);
-        uniformAmbientColourList.push_back(0);
-        uniformDirectionList.push_back(0);
-        uniformDiffuseIntensityList.push_back(0);
-        uniformSpecularIntensityList.push_back(0);
-        uniformShininessList.push_back(0);
+        perVertexMatrices = !perVertexMatrices;
+        printf("Vertex matrices: %s\n", perVertexMatrices ? "per vertex (inverse in the shader)" : "per object (computed on the CPU)");
     }
 }
 
-void setUniforms()
+void toggleTerrainLod()
 {
-    for (size_t i = 0; i < uniformModelList.size(); i++)
+    terrainLodToggleTime += deltaTime;
+
+    if (mainWindow.getKeys()[GLFW_KEY_Y] && terrainLodToggleTime >= 0.25f)
     {
-        uniformModelList.at(i) = shaderList[0]->getModelLocation();
-        uniformProjection = shaderList[0]->getProjectionLocation();
-        uniformView = shaderList[0]->getViewLocation();
+        terrainLodToggleTime = 0.0f;
 
-        uniformAmbientColourList.at(i) = shaderList[0]->getAmbientColourLocation();
-        uniformAmbientIntensityList.at(i) = shaderList[0]->getAmbientIntensityLocation();
-        uniformDirectionList.at(i) = shaderList[0]->getDirectionLocation();
-        uniformDiffuseIntensityList.at(i) = shaderList[0]->getDiffuseIntensityLocation();
+        terrainQuadtree.setLodEnabled(!terrainQuadtree.getLodEnabled());
+        printf("Terrain LOD: %s\n", terrainQuadtree.getLodEnabled() ? "on" : "off (full resolution)");
+    }
+}
+
+void reportTerrainStats()
+{
+    unsigned int visible = terrainQuadtree.getVisibleChunkCount();
+    unsigned int culled = terrainQuadtree.getCulledChunkCount();
+    unsigned int vertices = terrainQuadtree.getDrawnVertexCount();
 
-        uniformEyePosition = shaderList[0]->getEyePositionLocation();
+    // Only print when the camera has moved enough to change the result
+    if (visible != lastVisibleChunks || culled != lastCulledChunks || vertices != lastDrawnVertices)
+    {
+        printf("Terrain chunks: %u visible, %u culled (of %u), %u vertices drawn\n",
+            visible, culled, terrainQuadtree.getChunkCount(), vertices);
+        lastVisibleChunks = visible;
+        lastCulledChunks = culled;
+        lastDrawnVertices = vertices;
+    }
+}
 
-        uniformSpecularIntensityList.at(i) = shaderList[0]->getSpecularIntensityLocation();
-        uniformShininessList.at(i) = shaderList[0]->getShininessLocation();
+void reportGLStateCache()
+{
+    GLfloat now = glfwGetTime();
 
-        glUniformMatrix4fv(uniformModelList.at(i), 1, GL_FALSE, glm::value_ptr(modelList.at(i)));
+    if (now - lastGLStateReportTime >= 5.0f)
+    {
+        GLStateCache::report();
+        GLStateCache::resetCounters();
+        renderQueue.reportStats();
+        lastGLStateReportTime = now;
     }
 }
 
-void initialiseModelPositions() 
+void reportTerrainStreaming()
 {
-    glm::mat4 tempModel;
+    GLfloat now = glfwGetTime();
 
-    for (size_t i = 0; i < meshList.size(); i++)
+    if (now - lastStreamReportTime >= 5.0f)
     {
-        tempModel = glm::mat4(1.0f);
+        terrainStreamer.reportStats();
+        lastStreamReportTime = now;
+    }
+}
 
-        if (i != 0)
+void updateTransformations()
+{
+    const glm::mat4& model = terrainTransform.getWorldMatrix();
+    glm::mat4 viewProjection = projection * camera.calculateViewMatrix();
+
+    // The terrain's uniforms are set on whichever program draws it
+    Shader* shader = useIndirectDraws ? indirectShader : terrainShader;
+    shader->useShader();
+
+    // Render heightmaps. The terrain is one object, so its matrices are worked out right here.
+    // Cull against the same transform the vertex shader applies.
+    glm::mat4 clipMatrix = viewProjection * model;
+    glm::mat3 normalMatrix = glm::inverseTranspose(glm::mat3(model));
+
+    glUniformMatrix4fv(shader->getUniformLocation(UNIFORM_MODEL), 1, GL_FALSE, glm::value_ptr(model));
+    glUniformMatrix4fv(shader->getUniformLocation(UNIFORM_MVP), 1, GL_FALSE, glm::value_ptr(clipMatrix));
+    glUniformMatrix3fv(shader->getUniformLocation(UNIFORM_NORMAL_MATRIX), 1, GL_FALSE, glm::value_ptr(normalMatrix));
+
+    TerrainUniforms terrainUniforms;
+    terrainUniforms.lodLevel = shader->getUniformLocation(UNIFORM_LOD_LEVEL);
+    terrainUniforms.morphRange = shader->getUniformLocation(UNIFORM_MORPH_RANGE);
+    terrainUniforms.positionScale = shader->getUniformLocation(UNIFORM_POSITION_SCALE);
+    terrainUniforms.positionOffset = shader->getUniformLocation(UNIFORM_POSITION_OFFSET);
+    terrainUniforms.grid = shader->getUniformLocation(UNIFORM_TERRAIN_GRID);
+    terrainUniforms.levelCount = shader->getUniformLocation(UNIFORM_TERRAIN_LEVEL_COUNT);
+    terrainUniforms.baseVertex = shader->getUniformLocation(UNIFORM_BASE_VERTEX);
+
+    // Only the CPU side of the submission is timed here. The GPU timer covers the draws,
+    // except on the indirect path, which draws everything at the end of the frame.
+    if (!useIndirectDraws)
+    {
+        terrainGpuBenchmarks[perVertexMatrices].start();
+    }
+    terrainSubmitBenchmarks[terrainDrawMode].start();
+    if (streamTerrain)
+    {
+        terrainStreamer.render(clipMatrix, terrainDrawMode, terrainUniforms);
+    }
+    else if (useIndirectDraws)
+    {
+        terrainQuadtree.render(clipMatrix, camera.getCameraPosition(), model, indirectDraws, terrainUniforms);
+    }
+    else
+    {
+        terrainQuadtree.render(clipMatrix, camera.getCameraPosition(), terrainDrawMode, terrainUniforms);
+    }
+    terrainSubmitBenchmarks[terrainDrawMode].stop();
+    if (!useIndirectDraws)
+    {
+        terrainGpuBenchmarks[perVertexMatrices].stop();
+    }
+
+    if (streamTerrain)
+    {
+        reportTerrainStreaming();
+    }
+    else
+    {
+        reportTerrainStats();
+    }
+
+    // Scene objects: only entities whose transform changed are rebuilt, then the visible ones are queued
+    Frustum viewFrustum;
+    viewFrustum.extractPlanes(viewProjection);
+
+    sceneEntities.updateTransforms();
+    sceneEntities.queueDraws(renderQueue, meshShader, viewProjection, &viewFrustum);
+}
+
+void renderInstancingStress()
+{
+    // Instanced and indirect draws both look materials up by index
+    Shader* shader = useIndirectDraws ? indirectShader : meshShader;
+    shader->useShader();
+    shinyMaterial.UseMaterial(shader->getUniformLocation(UNIFORM_INSTANCE_SPECULAR_INTENSITY[0]),
+        shader->getUniformLocation(UNIFORM_INSTANCE_SHININESS[0]));
+    dullMaterial.UseMaterial(shader->getUniformLocation(UNIFORM_INSTANCE_SPECULAR_INTENSITY[1]),
+        shader->getUniformLocation(UNIFORM_INSTANCE_SHININESS[1]));
+
+    if (useInstancing)
+    {
+        dirtTexture.UseTexture();
+        glUniform1i(shader->getUniformLocation(UNIFORM_INSTANCED), 1);
+        meshList[1]->renderMeshInstanced();
+        glUniform1i(shader->getUniformLocation(UNIFORM_INSTANCED), 0);
+    }
+    else if (useIndirectDraws)
+    {
+        // Still one command per copy, but they are submitted together with the rest of the frame
+        for (size_t i = 0; i < stressInstances.size(); i++)
         {
-            tempModel = glm::translate(tempModel, glm::vec3(0.0f, 0.0f, -3.0f));
-            tempModel = glm::scale(tempModel, glm::vec3(0.3f, 0.3f, 0.3f));
-            tempModel = glm::rotate(tempModel, glm::radians(0.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-            tempModel = glm::rotate(tempModel, glm::radians(2.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-            tempModel = glm::rotate(tempModel, glm::radians(0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+            IndirectDrawData data;
+            data.model = stressInstances[i].model;
+            data.grid = glm::vec4(0.0f);
+            data.lod = glm::vec4(-1.0f, 0.0f, 0.0f, (GLfloat)stressInstances[i].material);
+
+            meshList[1]->addToDrawList(indirectDraws, data);
         }
+    }
+    else
+    {
+        // The path the scene objects take: a draw per copy through the render queue.
+        // Unculled, like the instanced and indirect paths, so the timings compare like for like.
+        glm::mat4 viewProjection = projection * camera.calculateViewMatrix();
 
-        // Add each model to the respective list
-        modelList.at(i) = tempModel;
+        stressEntities.updateTransforms();
+        stressEntities.queueDraws(renderQueue, meshShader, viewProjection, nullptr);
     }
 }
 
-void updateTransformations()
+// Times decode and vertex/index generation for every heightmap,
+// comparing a single thread against all cores
+void benchmarkHeightmapGeneration()
 {
-    // Loop through all existing models
-    for (size_t i = 0; i < modelList.size(); i++)
+    HeightmapGenerator serialGenerator(1);
+    Benchmark decodeBenchmark("PNG decode", 0);
+    Benchmark serialBenchmark("Generate (1 thread)", 0);
+    Benchmark parallelBenchmark("Generate (" + std::to_string(heightmapGenerator.getThreadCount()) + " threads)", 0);
+
+    for (size_t i = 0; i < sizeof(heightmapFiles) / sizeof(heightmapFiles[0]); i++)
     {
-        // Heightmap will not be transformed, therefore skip
-        if (i != 0)
+        int mapWidth, mapHeight, mapChannels;
+
+        decodeBenchmark.start();
+        unsigned char* data = stbi_load(heightmapFiles[i], &mapWidth, &mapHeight, &mapChannels, 0);
+        decodeBenchmark.stop();
+
+        if (!data)
         {
-            // Model Logic
-            modelList.at(i) = glm::translate(modelList.at(i), position);
-            modelList.at(i) = glm::scale(modelList.at(i), scale);
-            modelList.at(i) = glm::rotate(modelList.at(i), glm::radians(rotation.x), glm::vec3(1.0f, 0.0f, 0.0f));
-            modelList.at(i) = glm::rotate(modelList.at(i), glm::radians(rotation.y), glm::vec3(0.0f, 1.0f, 0.0f));
-            modelList.at(i) = glm::rotate(modelList.at(i), glm::radians(rotation.z), glm::vec3(0.0f, 0.0f, 1.0f));
+            printf("Failed to load %s\n", heightmapFiles[i]);
+            continue;
         }
 
-        // Lighting and Texturing Logic
-        // Access first pyramid object
-        if (i == 1)
+        std::vector<float> serialVertices, parallelVertices;
+        std::vector<unsigned int> serialIndices, parallelIndices;
+
+        serialBenchmark.start();
+        serialGenerator.generateVertices(data, mapWidth, mapHeight, mapChannels, heightmapYScale, heightmapYShift, serialVertices);
+        serialGenerator.generateIndices(mapWidth, mapHeight, serialIndices);
+        serialBenchmark.stop();
+
+        parallelBenchmark.start();
+        heightmapGenerator.generateVertices(data, mapWidth, mapHeight, mapChannels, heightmapYScale, heightmapYShift, parallelVertices);
+        heightmapGenerator.generateIndices(mapWidth, mapHeight, parallelIndices);
+        parallelBenchmark.stop();
+
+        stbi_image_free(data);
+
+        printf("%s (%d x %d)\n", heightmapFiles[i], mapHeight, mapWidth);
+        decodeBenchmark.report();
+        serialBenchmark.report();
+        parallelBenchmark.report();
+        printf("Outputs match: %s\n\n", serialVertices == parallelVertices && serialIndices == parallelIndices ? "yes" : "NO");
+
+        decodeBenchmark.reset();
+        serialBenchmark.reset();
+        parallelBenchmark.reset();
+    }
+}
+
+// Times terrain normal generation for every heightmap: scalar on one thread,
+// SSE on one thread and SSE on all cores
+void benchmarkTerrainNormals()
+{
+    HeightmapGenerator serialGenerator(1);
+    Benchmark scalarBenchmark("Normals (scalar, 1 thread)", 0);
+    Benchmark simdBenchmark("Normals (SSE, 1 thread)", 0);
+    Benchmark parallelBenchmark("Normals (SSE, " + std::to_string(heightmapGenerator.getThreadCount()) + " threads)", 0);
+
+    for (size_t i = 0; i < sizeof(heightmapFiles) / sizeof(heightmapFiles[0]); i++)
+    {
+        int mapWidth, mapHeight, mapChannels;
+        unsigned short* data = stbi_load_16(heightmapFiles[i], &mapWidth, &mapHeight, &mapChannels, 0);
+
+        if (!data)
         {
-            shinyMaterial.UseMaterial(uniformSpecularIntensityList.at(i), uniformShininessList.at(i));
-            brickTexture.UseTexture();
+            printf("Failed to load %s\n", heightmapFiles[i]);
+            continue;
         }
-        // Access next 2 cube objects
-        else if (i == 2)
+
+        std::vector<float> vertices;
+        heightmapGenerator.generateVertices(data, mapWidth, mapHeight, mapChannels, heightmapYScale, heightmapYShift, vertices);
+        stbi_image_free(data);
+
+        std::vector<GLuint> scalarNormals, simdNormals, parallelNormals;
+
+        // Run each a few times, the smaller maps finish too quickly to time once
+        for (int run = 0; run < 5; run++)
         {
-            shinyMaterial.UseMaterial(uniformSpecularIntensityList.at(i), uniformShininessList.at(i));
-            dirtTexture.UseTexture();
+            serialGenerator.setSimdEnabled(false);
+            scalarBenchmark.start();
+            serialGenerator.generateNormals(&vertices[1], 3, mapWidth, mapHeight, scalarNormals);
+            scalarBenchmark.stop();
+
+            serialGenerator.setSimdEnabled(true);
+            simdBenchmark.start();
+            serialGenerator.generateNormals(&vertices[1], 3, mapWidth, mapHeight, simdNormals);
+            simdBenchmark.stop();
+
+            parallelBenchmark.start();
+            heightmapGenerator.generateNormals(&vertices[1], 3, mapWidth, mapHeight, parallelNormals);
+            parallelBenchmark.stop();
         }
-        else if (i == 3)
+
+        printf("%s (%d x %d)\n", heightmapFiles[i], mapHeight, mapWidth);
+        scalarBenchmark.report();
+        simdBenchmark.report();
+        parallelBenchmark.report();
+        printf("Outputs match: %s\n\n", scalarNormals == simdNormals && simdNormals == parallelNormals ? "yes" : "NO");
+
+        scalarBenchmark.reset();
+        simdBenchmark.reset();
+        parallelBenchmark.reset();
+    }
+}
+
+// Times building world matrices for batches of objects: the GLM translate / scale / rotate
+// chain against the SSE kernel, on one thread and on all cores
+void benchmarkTransforms()
+{
+    TransformKernel serialKernel(1);
+    TransformKernel parallelKernel;
+    const size_t batchSizes[] = { 1000, 10000, 100000, 1000000 };
+
+    Benchmark scalarBenchmark("Transforms (GLM, 1 thread)", 0);
+    Benchmark simdBenchmark("Transforms (SSE, 1 thread)", 0);
+    Benchmark parallelBenchmark("Transforms (SSE, " + std::to_string(parallelKernel.getThreadCount()) + " threads)", 0);
+
+    glm::mat4 parent = sceneObjectPlacement.getWorldMatrix();
+
+    for (size_t b = 0; b < sizeof(batchSizes) / sizeof(batchSizes[0]); b++)
+    {
+        size_t count = batchSizes[b];
+        std::vector<glm::vec3> positions(count), rotations(count), scales(count);
+        std::vector<glm::mat4> scalarMatrices(count), simdMatrices(count), parallelMatrices(count);
+
+        // Every object turns about every axis, so the kernel can't skip any trig
+        for (size_t i = 0; i < count; i++)
         {
-            dullMaterial.UseMaterial(uniformSpecularIntensityList.at(i), uniformShininessList.at(i));
-            dirtTexture.UseTexture();
+            positions[i] = glm::vec3((GLfloat)(i % 100), (GLfloat)(i % 7), -(GLfloat)(i / 100));
+            rotations[i] = glm::vec3((GLfloat)(i % 360) + 0.5f, (GLfloat)(i * 7 % 360) + 0.5f, (GLfloat)(i * 13 % 360) + 0.5f);
+            scales[i] = glm::vec3(0.5f + (i % 5) * 0.25f);
         }
 
-        // Rendering Logic
-        // Render heightmaps
-        if (i == 0)
+        for (int run = 0; run < 5; run++)
         {
-            meshList[i]->renderMeshFromHeightmap(NUM_STRIPS, NUM_VERTS_PER_STRIP);
+            serialKernel.setSimdEnabled(false);
+            scalarBenchmark.start();
+            serialKernel.compose(parent, &positions[0], &rotations[0], &scales[0], nullptr, count, &scalarMatrices[0], nullptr);
+            scalarBenchmark.stop();
+
+            serialKernel.setSimdEnabled(true);
+            simdBenchmark.start();
+            serialKernel.compose(parent, &positions[0], &rotations[0], &scales[0], nullptr, count, &simdMatrices[0], nullptr);
+            simdBenchmark.stop();
+
+            parallelBenchmark.start();
+            parallelKernel.compose(parent, &positions[0], &rotations[0], &scales[0], nullptr, count, &parallelMatrices[0], nullptr);
+            parallelBenchmark.stop();
         }
-        // Render normal meshes
-        else
+
+        // The expanded rotation rounds differently from the chain of multiplies
+        GLfloat maxError = 0.0f;
+        for (size_t i = 0; i < count; i++)
+        {
+            for (int column = 0; column < 4; column++)
+            {
+                glm::vec4 simdError = glm::abs(scalarMatrices[i][column] - simdMatrices[i][column]);
+                glm::vec4 parallelError = glm::abs(scalarMatrices[i][column] - parallelMatrices[i][column]);
+                maxError = glm::max(maxError, glm::max(glm::max(simdError.x, simdError.y), glm::max(simdError.z, simdError.w)));
+                maxError = glm::max(maxError, glm::max(glm::max(parallelError.x, parallelError.y), glm::max(parallelError.z, parallelError.w)));
+            }
+        }
+
+        printf("%zu objects\n", count);
+        scalarBenchmark.report();
+        simdBenchmark.report();
+        parallelBenchmark.report();
+        printf("Largest difference from GLM: %g\n\n", maxError);
+
+        scalarBenchmark.reset();
+        simdBenchmark.reset();
+        parallelBenchmark.reset();
+    }
+}
+
+// Times getting the height samples of every heightmap into memory,
+// decoding the PNG against mapping the converted .hmt file
+void benchmarkHeightmapFormats()
+{
+    Benchmark pngBenchmark("PNG decode", 0);
+    Benchmark tiledBenchmark("HMT map + read", 0);
+
+    for (size_t i = 0; i < sizeof(heightmapFiles) / sizeof(heightmapFiles[0]); i++)
+    {
+        std::string tiledFile = getPathWithExtension(heightmapFiles[i], ".hmt");
+
+        // Convert on demand so the benchmark can run on a fresh checkout
+        TiledHeightmap tiledHeightmap(tiledFile.c_str());
+        if (!tiledHeightmap.open())
+        {
+            if (!convertHeightmap(heightmapFiles[i], tiledFile.c_str()) || !tiledHeightmap.open())
+            {
+                continue;
+            }
+        }
+        tiledHeightmap.close();
+
+        int mapWidth, mapHeight, mapChannels;
+        std::vector<float> pngSamples, tiledSamples;
+
+        pngBenchmark.start();
+        unsigned char* data = stbi_load(heightmapFiles[i], &mapWidth, &mapHeight, &mapChannels, 0);
+        if (data)
+        {
+            pngSamples.resize((size_t)mapWidth * mapHeight);
+            for (size_t j = 0; j < pngSamples.size(); j++)
+            {
+                pngSamples[j] = data[j * mapChannels];
+            }
+            stbi_image_free(data);
+        }
+        pngBenchmark.stop();
+
+        if (!data)
         {
-            //meshList[i]->renderMesh();
+            printf("Failed to load %s\n", heightmapFiles[i]);
+            continue;
         }
+
+        tiledBenchmark.start();
+        bool tiledLoaded = tiledHeightmap.open() &&
+            tiledHeightmap.readRegion(0, 0, tiledHeightmap.getHeight(), tiledHeightmap.getWidth(), tiledSamples);
+        tiledHeightmap.close();
+        tiledBenchmark.stop();
+
+        printf("%s (%d x %d)\n", heightmapFiles[i], mapHeight, mapWidth);
+        pngBenchmark.report();
+        tiledBenchmark.report();
+        printf("Samples match: %s\n\n", tiledLoaded && pngSamples == tiledSamples ? "yes" : "NO");
+
+        pngBenchmark.reset();
+        tiledBenchmark.reset();
     }
 }
 
-int main(void)
+int main(int argc, char** argv)
 {
+    for (int i = 1; i < argc; i++)
+    {
+        // Benchmarks run without opening a window
+        if (strcmp(argv[i], "--bench-heightmaps") == 0)
+        {
+            benchmarkHeightmapGeneration();
+            return 0;
+        }
+        else if (strcmp(argv[i], "--bench-terrain-normals") == 0)
+        {
+            benchmarkTerrainNormals();
+            return 0;
+        }
+        else if (strcmp(argv[i], "--bench-transforms") == 0)
+        {
+            benchmarkTransforms();
+            return 0;
+        }
+        else if (strcmp(argv[i], "--bench-heightmap-formats") == 0)
+        {
+            benchmarkHeightmapFormats();
+            return 0;
+        }
+        else if (strcmp(argv[i], "--convert-heightmaps") == 0)
+        {
+            convertAllHeightmaps();
+            return 0;
+        }
+        else if (strcmp(argv[i], "--convert-heightmap") == 0 && i + 2 < argc)
+        {
+            return convertHeightmap(argv[i + 1], argv[i + 2]) ? 0 : 1;
+        }
+        else if (strcmp(argv[i], "--no-terrain-bake") == 0)
+        {
+            useTerrainBake = false;
+        }
+        else if (strcmp(argv[i], "--no-shader-cache") == 0)
+        {
+            useShaderBinaries = false;
+        }
+        else if (strcmp(argv[i], "--heightmap") == 0 && i + 1 < argc)
+        {
+            heightmapFile = argv[++i];
+        }
+        else if (strcmp(argv[i], "--stream-terrain") == 0)
+        {
+            streamTerrain = true;
+        }
+        else if (strcmp(argv[i], "--stream-budget-mb") == 0 && i + 1 < argc)
+        {
+            int budget = atoi(argv[++i]);
+
+            if (budget > 0)
+            {
+                terrainStreamBudgetMB = budget;
+            }
+            else
+            {
+                printf("--stream-budget-mb needs a positive number of megabytes, keeping %zu\n", terrainStreamBudgetMB);
+            }
+        }
+        else if (strcmp(argv[i], "--report-gl-state") == 0)
+        {
+            reportGLState = true;
+        }
+        else if (strcmp(argv[i], "--indirect-draws") == 0)
+        {
+            useIndirectDraws = true;
+        }
+        else if (strcmp(argv[i], "--instancing-stress") == 0 && i + 1 < argc)
+        {
+            instancingStressCount = atoi(argv[++i]);
+        }
+    }
+
     mainWindow = Window(screenWidth, screenHeight);
     mainWindow.initialise();
 
+    if (useIndirectDraws && !IndirectDrawList::isSupported())
+    {
+        printf("Multi-draw indirect needs ARB_multi_draw_indirect and ARB_shader_draw_parameters, drawing directly instead\n");
+        useIndirectDraws = false;
+    }
+
+    requestShaders();
     createHeightMap();
     createObjects();
-    createShaders();
+    finishShaders();
+
+    if (instancingStressCount > 0)
+    {
+        createInstancingStressScene();
+    }
 
     camera = Camera(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f), -90.0f, 0.0f, 15.0f, 0.25f);
 
@@ -464,12 +1194,28 @@ int main(void)
                      /* r     g      b    aI    x     y     z     dI */
     mainLight = Light(0.5f, 0.5f, 0.5f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f);
 
-    projection = glm::perspective(glm::radians(45.0f), mainWindow.getBufferWidth() / mainWindow.getBufferHeight(), 0.1f, 100.0f);
+    // The light doesn't move, so the scene block is only written once
+    frameUniformBuffer.create(FRAME_UNIFORM_BINDING, sizeof(FrameUniforms));
+    sceneUniformBuffer.create(SCENE_UNIFORM_BINDING, sizeof(SceneUniforms));
+    mainLight.UseLight(sceneUniforms);
+    sceneUniformBuffer.update(&sceneUniforms, sizeof(sceneUniforms));
+
+    projection = glm::perspective(glm::radians(fieldOfView), mainWindow.getBufferWidth() / mainWindow.getBufferHeight(), 0.1f, farPlane);
 
-    initialiseUniforms();
+    // LOD bands depend on how many pixels a unit of height error covers
+    terrainQuadtree.setLodParameters(mainWindow.getBufferHeight(), glm::radians(fieldOfView), terrainLodPixelTolerance);
 
     while (!mainWindow.getShouldClose())
     {
+        // Whole frame, including the swap, so GPU cost shows up once the driver queue fills.
+        // The mode is latched here since N can flip it mid frame.
+        StressDrawMode stressDrawMode = useInstancing ? STRESS_INSTANCED : useIndirectDraws ? STRESS_INDIRECT : STRESS_PER_MESH;
+        Benchmark& stressFrameBenchmark = stressFrameBenchmarks[stressDrawMode];
+        if (instancingStressCount > 0)
+        {
+            stressFrameBenchmark.start();
+        }
+
         GLfloat now = glfwGetTime();
         deltaTime = now - lastTime;
         lastTime = now;
@@ -480,35 +1226,85 @@ int main(void)
         camera.keyControl(mainWindow.getKeys(), deltaTime);
         camera.mouseControl(mainWindow.getXChange(), mainWindow.getYChange());
 
+        toggleTerrainDrawMode();
+        toggleTerrainLod();
+        toggleInstancing();
+        toggleMatrixMode();
+        reloadShaders();
+
+        // Upload whatever textures have finished decoding, within the frame's budget
+        assetLoader.update();
+
+        // Pick up tiles the loader has finished and request new ones
+        if (streamTerrain)
+        {
+            terrainStreamer.update(camera.getCameraPosition(), terrainUploadsPerFrame);
+        }
+
         glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        shaderList[0]->useShader();
-
         #pragma region Update Model Transformations
-        setUniforms();
+        // Projection, view and eye position, shared by every shader
+        frameUniforms.projection = projection;
+        frameUniforms.view = camera.calculateViewMatrix();
+        frameUniforms.eyePosition = camera.getCameraPosition();
+        frameUniforms.perVertexMatrices = perVertexMatrices;
+        frameUniformBuffer.update(&frameUniforms, sizeof(frameUniforms));
+
+        if (useIndirectDraws)
+        {
+            indirectDraws.begin();
+        }
 
-        // Projection
-        glUniformMatrix4fv(uniformProjection, 1, GL_FALSE, glm::value_ptr(projection));
+        renderQueue.begin(camera.getCameraPosition(), farPlane);
 
-        // View
-        glUniformMatrix4fv(uniformView, 1, GL_FALSE, glm::value_ptr(camera.calculateViewMatrix()));
+        updateTransformations();
+        #pragma endregion
 
-        // Eye position
-        glUniform3f(uniformEyePosition, camera.getCameraPosition().x, camera.getCameraPosition().y, camera.getCameraPosition().z);
+        if (instancingStressCount > 0)
+        {
+            renderInstancingStress();
+        }
 
-        mainLight.UseLight(uniformAmbientIntensityList.at(0), uniformAmbientColourList.at(0),
-            uniformDiffuseIntensityList.at(0), uniformDirectionList.at(0));
+        renderQueue.submit();
 
-        initialiseModelPositions();
+        if (useIndirectDraws)
+        {
+            indirectSubmitBenchmark.start();
+            indirectShader->useShader();
+            // Every textured draw in the submission is a stress copy. Terrain vertices skip the texture.
+            dirtTexture.UseTexture();
+            indirectDraws.submit(indirectShader->getUniformLocation(UNIFORM_INDIRECT),
+                indirectShader->getUniformLocation(UNIFORM_DRAW_DATA_OFFSET));
+            indirectSubmitBenchmark.stop();
+        }
 
-        updateTransformations();
-        #pragma endregion
+        // Whichever program drew last stays bound into the next frame; useShader skips rebinding it
+        mainWindow.swapBuffers();
 
-        glUseProgram(0);
+        if (reportGLState)
+        {
+            reportGLStateCache();
+        }
 
-        mainWindow.swapBuffers();
+        if (instancingStressCount > 0)
+        {
+            stressFrameBenchmark.stop();
+        }
+    }
+
+    // Let the loader threads finish while the GL context is still around
+    assetLoader.stop();
+    terrainStreamer.stop();
+    delete terrainTileSource;
+
+    // Their queries belong to the context too
+    for (size_t i = 0; i < sizeof(terrainGpuBenchmarks) / sizeof(terrainGpuBenchmarks[0]); i++)
+    {
+        terrainGpuBenchmarks[i].clear();
     }
+    shaderCache.clear();
 
     return 0;
 }
\ No newline at end of file
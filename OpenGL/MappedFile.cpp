@@ -0,0 +1,128 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+MappedFile::MappedFile()
+{
+	data = nullptr;
+	size = 0;
+
+#ifdef _WIN32
+	fileHandle = INVALID_HANDLE_VALUE;
+	mappingHandle = nullptr;
+#else
+	fileDescriptor = -1;
+#endif
+}
+
+bool MappedFile::open(const char* fileLocation)
+{
+	close();
+
+#ifdef _WIN32
+	fileHandle = CreateFileA(fileLocation, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (fileHandle == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0)
+	{
+		close();
+		return false;
+	}
+	size = (size_t)fileSize.QuadPart;
+
+	mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!mappingHandle)
+	{
+		close();
+		return false;
+	}
+
+	data = (const unsigned char*)MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+#else
+	fileDescriptor = ::open(fileLocation, O_RDONLY);
+	if (fileDescriptor < 0)
+	{
+		return false;
+	}
+
+	struct stat fileInfo;
+	if (fstat(fileDescriptor, &fileInfo) != 0 || fileInfo.st_size == 0)
+	{
+		close();
+		return false;
+	}
+	size = (size_t)fileInfo.st_size;
+
+	void* mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+	data = mapping == MAP_FAILED ? nullptr : (const unsigned char*)mapping;
+#endif
+
+	if (!data)
+	{
+		close();
+		return false;
+	}
+
+	return true;
+}
+
+void MappedFile::close()
+{
+#ifdef _WIN32
+	if (data)
+	{
+		UnmapViewOfFile(data);
+	}
+	if (mappingHandle)
+	{
+		CloseHandle(mappingHandle);
+		mappingHandle = nullptr;
+	}
+	if (fileHandle != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(fileHandle);
+		fileHandle = INVALID_HANDLE_VALUE;
+	}
+#else
+	if (data)
+	{
+		munmap((void*)data, size);
+	}
+	if (fileDescriptor >= 0)
+	{
+		::close(fileDescriptor);
+		fileDescriptor = -1;
+	}
+#endif
+
+	data = nullptr;
+	size = 0;
+}
+
+const unsigned char* MappedFile::getData()
+{
+	return data;
+}
+
+size_t MappedFile::getSize()
+{
+	return size;
+}
+
+MappedFile::~MappedFile()
+{
+	close();
+}
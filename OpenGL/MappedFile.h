@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stddef.h>
+
+// Read-only memory mapping of a whole file
+class MappedFile
+{
+public:
+	MappedFile();
+
+	bool open(const char* fileLocation);
+	void close();
+
+	const unsigned char* getData();
+	size_t getSize();
+
+	~MappedFile();
+
+private:
+	const unsigned char* data;
+	size_t size;
+
+#ifdef _WIN32
+	void* fileHandle;
+	void* mappingHandle;
+#else
+	int fileDescriptor;
+#endif
+};
@@ -1,3 +1,4 @@
+#include <stddef.h>
 #include <vector>
 #include <iostream>
 
@@ -8,103 +9,312 @@ Mesh::Mesh()
 	VAO = 0;
 	VBO = 0;
 	IBO = 0;
+	instanceVBO = 0;
 	indexCount = 0;
+	instanceCount = 0;
+	arena = nullptr;
+	allocation = GeometryAllocation();
 }
 
-void Mesh::createMesh(GLfloat* vertices, unsigned int* indices, unsigned int numOfVertices, unsigned int numOfIndices)
+Mesh::Mesh(GeometryArena* geometryArena)
 {
-	indexCount = numOfIndices;
+	VAO = 0;
+	VBO = 0;
+	IBO = 0;
+	instanceVBO = 0;
+	indexCount = 0;
+	instanceCount = 0;
+	arena = geometryArena;
+	allocation = GeometryAllocation();
+}
 
-	glGenVertexArrays(1, &VAO);
-	glBindVertexArray(VAO);
+size_t Mesh::getVertexSize(GeometryFormat format)
+{
+	if (format == GEOMETRY_FORMAT_TERRAIN)
+	{
+		return sizeof(TerrainVertex);
+	}
 
-	glGenBuffers(1, &IBO);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, IBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices[0]) * numOfIndices, indices, GL_STATIC_DRAW);
+	// x y z, u v, Nx Ny Nz
+	return sizeof(GLfloat) * 8;
+}
 
-	glGenBuffers(1, &VBO);
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices[0]) * numOfVertices, vertices, GL_STATIC_DRAW);
+void Mesh::setVertexAttributes(GeometryFormat format)
+{
+	GLsizei stride = (GLsizei)getVertexSize(format);
+
+	if (format == GEOMETRY_FORMAT_TERRAIN)
+	{
+		// Light. Normals are packed as signed 10-bit components.
+		glVertexAttribPointer(2, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, (void*)offsetof(TerrainVertex, normal));
+		glEnableVertexAttribArray(2);
+
+		// Height and morph target height. Not normalized, so the shader sees the raw samples.
+		// Position and texture attributes are left disabled; the shader rebuilds the position.
+		glVertexAttribPointer(3, 2, GL_UNSIGNED_SHORT, GL_FALSE, stride, (void*)offsetof(TerrainVertex, height));
+		glEnableVertexAttribArray(3);
+		return;
+	}
 
 	// (LocationOfAttribute,
 	// XYZ which are 3 values,
-	// TypeOfValues, 
+	// TypeOfValues,
 	// NormaliseValues,
 	// Stride(take a vertex value and skip n amount)
 	// Offset(where the data starts))
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(vertices[0]) * 8, 0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, 0);
 	glEnableVertexAttribArray(0);
 
 	// Texture
-	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(vertices[0]) * 8, (void*)(sizeof(vertices[0]) * 3));
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(GLfloat) * 3));
 	glEnableVertexAttribArray(1);
 
 	//Light
-	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(vertices[0]) * 8, (void*)(sizeof(vertices[0]) * 5));
+	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(GLfloat) * 5));
 	glEnableVertexAttribArray(2);
+}
+
+void Mesh::createMesh(GLfloat* vertices, unsigned int* indices, unsigned int numOfVertices, unsigned int numOfIndices)
+{
+	indexCount = numOfIndices;
 
-	// Unbinding
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	// numOfVertices counts floats, 8 to a vertex
+	if (arena)
+	{
+		if (arena->allocate(vertices, numOfVertices / 8, indices, numOfIndices, allocation))
+		{
+			return;
+		}
 
-	glBindVertexArray(0);
+		// The arena couldn't make room, so the mesh gets buffers of its own instead
+		printf("Mesh didn't fit in its geometry arena, using its own buffers\n");
+		arena = nullptr;
+	}
+
+	glGenVertexArrays(1, &VAO);
+	GLStateCache::bindVertexArray(VAO);
+
+	// The VAO keeps the element buffer bound, so drawing only has to bind the VAO
+	glGenBuffers(1, &IBO);
+	GLStateCache::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, IBO);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices[0]) * numOfIndices, indices, GL_STATIC_DRAW);
+
+	glGenBuffers(1, &VBO);
+	GLStateCache::bindBuffer(GL_ARRAY_BUFFER, VBO);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices[0]) * numOfVertices, vertices, GL_STATIC_DRAW);
+
+	setVertexAttributes(GEOMETRY_FORMAT_MESH);
+}
+
+void Mesh::createMeshFromHeightmap(const std::vector<TerrainVertex>& vertices, const std::vector<unsigned int>& indices)
+{
+	createMeshFromHeightmap(&vertices[0], vertices.size(), &indices[0], indices.size());
 }
 
-void Mesh::createMeshFromHeightmap(std::vector<float> vertices, std::vector<unsigned int> indices)
+void Mesh::createMeshFromHeightmap(const TerrainVertex* vertices, size_t numOfVertices, const GLuint* indices, size_t numOfIndices)
 {
+	indexCount = numOfIndices;
+
+	if (arena)
+	{
+		if (arena->allocate(vertices, numOfVertices, indices, numOfIndices, allocation))
+		{
+			return;
+		}
+
+		printf("Mesh didn't fit in its geometry arena, using its own buffers\n");
+		arena = nullptr;
+	}
+
 	// Register VAO
 	glGenVertexArrays(1, &VAO);
-	glBindVertexArray(VAO);
+	GLStateCache::bindVertexArray(VAO);
 
 	glGenBuffers(1, &VBO);
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), &vertices[0], GL_STATIC_DRAW);
+	GLStateCache::bindBuffer(GL_ARRAY_BUFFER, VBO);
+	glBufferData(GL_ARRAY_BUFFER, numOfVertices * sizeof(TerrainVertex), vertices, GL_STATIC_DRAW);
 
 	glGenBuffers(1, &IBO);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, IBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+	GLStateCache::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, IBO);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, numOfIndices * sizeof(GLuint), indices, GL_STATIC_DRAW);
 
-	// Position
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
-	glEnableVertexAttribArray(0);
+	setVertexAttributes(GEOMETRY_FORMAT_TERRAIN);
+}
 
-	// Texture
-	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(vertices[0]) * 3, (void*)0);
-	glEnableVertexAttribArray(1);
+void Mesh::setInstances(const std::vector<MeshInstance>& instances)
+{
+	instanceCount = (GLsizei)instances.size();
 
-	// Light
-	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(vertices[0]) * 3, (void*)0);
-	glEnableVertexAttribArray(2);
+	bool firstUpload = instanceVBO == 0;
+	if (firstUpload)
+	{
+		glGenBuffers(1, &instanceVBO);
+	}
+
+	GLStateCache::bindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+
+	// Respecified every call so the driver can orphan the old storage
+	glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(MeshInstance), instances.empty() ? nullptr : &instances[0], GL_DYNAMIC_DRAW);
+
+	// A mesh with its own VAO only needs the instance attributes set up once.
+	// Arena meshes share their VAO, so they set them up around each instanced draw instead.
+	if (firstUpload && !arena)
+	{
+		GLStateCache::bindVertexArray(VAO);
+		bindInstanceAttributes();
+	}
+}
+
+void Mesh::bindInstanceAttributes()
+{
+	GLStateCache::bindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+
+	// Model matrix, one column per attribute (4 - 7). Divisor 1 steps once per instance.
+	GLsizei stride = sizeof(MeshInstance);
+	for (GLuint column = 0; column < 4; column++)
+	{
+		glVertexAttribPointer(4 + column, 4, GL_FLOAT, GL_FALSE, stride, (void*)(offsetof(MeshInstance, model) + sizeof(glm::vec4) * column));
+		glEnableVertexAttribArray(4 + column);
+		glVertexAttribDivisor(4 + column, 1);
+	}
+
+	// Material index, kept as an integer
+	glVertexAttribIPointer(8, 1, GL_UNSIGNED_INT, stride, (void*)offsetof(MeshInstance, material));
+	glEnableVertexAttribArray(8);
+	glVertexAttribDivisor(8, 1);
 }
 
 void Mesh::renderMesh()
 {
-	glBindVertexArray(VAO);
+	if (arena)
+	{
+		arena->draw(allocation);
+		return;
+	}
 
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, IBO);
+	GLStateCache::bindVertexArray(VAO);
 	glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+void Mesh::renderMeshInstanced()
+{
+	if (instanceCount == 0)
+	{
+		return;
+	}
+
+	if (arena)
+	{
+		arena->bind(allocation.block);
+		bindInstanceAttributes();
+
+		glDrawElementsInstancedBaseVertex(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT,
+			(void*)(sizeof(GLuint) * allocation.firstIndex), instanceCount, allocation.baseVertex);
+
+		// Other meshes in the block aren't instanced
+		for (GLuint attribute = 4; attribute <= 8; attribute++)
+		{
+			glDisableVertexAttribArray(attribute);
+		}
+
+		// Leave the shared block unbound so the next user binds it through the state cache
+		GLStateCache::bindVertexArray(0);
+		return;
+	}
 
-	glBindVertexArray(0);
+	GLStateCache::bindVertexArray(VAO);
+	glDrawElementsInstanced(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0, instanceCount);
 }
 
-void Mesh::renderMeshFromHeightmap(int numStrips, int numVertsPerStrip)
+void Mesh::renderMeshFromHeightmap(GLsizei firstIndex, int numStrips, int numVertsPerStrip, TerrainDrawMode drawMode)
 {
-	glBindVertexArray(VAO);
+	// Ranges are relative to this mesh, so arena meshes shift them to where it was placed
+	GLsizei indexStart = firstIndex;
+	GLint baseVertex = 0;
 
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, IBO);
-	for (unsigned int strip = 0; strip < numStrips - 1; strip++)
+	if (arena)
 	{
-		glDrawElements(
+		arena->bind(allocation.block);
+		indexStart += allocation.firstIndex;
+		baseVertex = allocation.baseVertex;
+	}
+	else
+	{
+		GLStateCache::bindVertexArray(VAO);
+	}
+
+	if (drawMode == TERRAIN_DRAW_PRIMITIVE_RESTART)
+	{
+		// Every strip ends in a restart index, so the whole range is one draw call.
+		// The restart index is compared before the base vertex is added.
+		glEnable(GL_PRIMITIVE_RESTART);
+		glPrimitiveRestartIndex(HEIGHTMAP_RESTART_INDEX);
+		glDrawElementsBaseVertex(
 			GL_TRIANGLE_STRIP,
-			numVertsPerStrip,
+			numStrips * (numVertsPerStrip + 1),
 			GL_UNSIGNED_INT,
-			(void*)(sizeof(unsigned int) * numVertsPerStrip * strip)
+			(void*)(sizeof(unsigned int) * indexStart),
+			baseVertex
 		);
+		glDisable(GL_PRIMITIVE_RESTART);
+	}
+	else
+	{
+		// Skip over the restart index that follows each strip
+		for (unsigned int strip = 0; strip < numStrips; strip++)
+		{
+			glDrawElementsBaseVertex(
+				GL_TRIANGLE_STRIP,
+				numVertsPerStrip,
+				GL_UNSIGNED_INT,
+				(void*)(sizeof(unsigned int) * (indexStart + (numVertsPerStrip + 1) * strip)),
+				baseVertex
+			);
+		}
+	}
+}
+
+bool Mesh::addToDrawList(IndirectDrawList& drawList, const IndirectDrawData& data)
+{
+	if (!arena)
+	{
+		return false;
+	}
+
+	DrawElementsIndirectCommand command;
+	command.count = indexCount;
+	command.instanceCount = 1;
+	command.firstIndex = allocation.firstIndex;
+	command.baseVertex = allocation.baseVertex;
+	command.baseInstance = 0;
+
+	drawList.addDraw(arena, allocation.block, GL_TRIANGLES, command, data);
+	return true;
+}
+
+bool Mesh::addHeightmapToDrawList(IndirectDrawList& drawList, GLsizei firstIndex, int numStrips, int numVertsPerStrip,
+	const IndirectDrawData& data)
+{
+	if (!arena)
+	{
+		return false;
 	}
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 
-	glBindVertexArray(0);
+	// Always the primitive restart layout, a whole level is one command
+	DrawElementsIndirectCommand command;
+	command.count = numStrips * (numVertsPerStrip + 1);
+	command.instanceCount = 1;
+	command.firstIndex = allocation.firstIndex + firstIndex;
+	command.baseVertex = allocation.baseVertex;
+	command.baseInstance = 0;
+
+	drawList.addDraw(arena, allocation.block, GL_TRIANGLE_STRIP, command, data);
+	return true;
+}
+
+GLint Mesh::getBaseVertex()
+{
+	return arena ? allocation.baseVertex : 0;
 }
 
 void Mesh::clearMesh()
@@ -117,18 +327,29 @@ void Mesh::clearMesh()
 	if (VBO != 0)
 	{
 		glDeleteBuffers(1, &VBO);
+		GLStateCache::forgetBuffer(VBO);
 		VBO = 0;
 	}
+	if (instanceVBO != 0)
+	{
+		glDeleteBuffers(1, &instanceVBO);
+		GLStateCache::forgetBuffer(instanceVBO);
+		instanceVBO = 0;
+	}
 	if (VAO != 0)
 	{
 		glDeleteVertexArrays(1, &VAO);
+		GLStateCache::forgetVertexArray(VAO);
 		VAO = 0;
 	}
 
+	// Arena space is only released when the whole arena is cleared
+	arena = nullptr;
 	indexCount = 0;
+	instanceCount = 0;
 }
 
 Mesh::~Mesh()
 {
 	clearMesh();
-}
\ No newline at end of file
+}
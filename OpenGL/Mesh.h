@@ -1,21 +1,76 @@
 #pragma once
 
+#include <vector>
+
 #include <GL\glew.h>
 
+#include <glm\glm.hpp>
+
+#include "GeometryArena.h"
+#include "IndirectDrawList.h"
+
+// Index written between heightmap strips so they can be drawn in one call
+const GLuint HEIGHTMAP_RESTART_INDEX = 0xFFFFFFFF;
+
+// Heightmap vertex, 8 bytes. Only the 16-bit height samples and a packed normal are stored;
+// the vertex shader works out x, z and the morph level from gl_VertexID and the chunk's grid.
+struct TerrainVertex
+{
+	GLushort height;
+	GLushort morphHeight;
+	GLuint normal;
+};
+
+// One copy of an instanced mesh. material indexes the shader's instanceMaterials.
+struct MeshInstance
+{
+	glm::mat4 model;
+	GLuint material;
+};
+
+// How a heightmap mesh submits its triangle strips
+enum TerrainDrawMode
+{
+	TERRAIN_DRAW_PER_STRIP,
+	TERRAIN_DRAW_PRIMITIVE_RESTART
+};
+
 class Mesh
 {
 public:
 	Mesh();
+	// Meshes given an arena are suballocated from it instead of owning their own buffers
+	Mesh(GeometryArena* geometryArena);
+
+	static size_t getVertexSize(GeometryFormat format);
+	// Describes the format's attributes to the bound VAO, reading from the bound array buffer
+	static void setVertexAttributes(GeometryFormat format);
 
 	void createMesh(GLfloat* vertices, unsigned int* indices, unsigned int numOfVertices, unsigned int numOfIndices);
-	void createMeshFromHeightmap(std::vector<float> vertices, std::vector<unsigned int> indices);
+	void createMeshFromHeightmap(const std::vector<TerrainVertex>& vertices, const std::vector<unsigned int>& indices);
+	void createMeshFromHeightmap(const TerrainVertex* vertices, size_t numOfVertices, const GLuint* indices, size_t numOfIndices);
+	void setInstances(const std::vector<MeshInstance>& instances);
 	void renderMesh();
-	void renderMeshFromHeightmap(int numStrips, int numVertsPerStrip);
+	void renderMeshInstanced();
+	void renderMeshFromHeightmap(GLsizei firstIndex, int numStrips, int numVertsPerStrip, TerrainDrawMode drawMode);
 	void clearMesh();
 
+	// Queue the draw in drawList instead of issuing it. Only arena meshes can be queued.
+	bool addToDrawList(IndirectDrawList& drawList, const IndirectDrawData& data);
+	bool addHeightmapToDrawList(IndirectDrawList& drawList, GLsizei firstIndex, int numStrips, int numVertsPerStrip,
+		const IndirectDrawData& data);
+
+	// Added to gl_VertexID by base-vertex draws, so the terrain shader subtracts it again
+	GLint getBaseVertex();
+
 	~Mesh();
 
 private:
-	GLuint VAO, VBO, IBO;
-	GLsizei indexCount;
+	GLuint VAO, VBO, IBO, instanceVBO;
+	GLsizei indexCount, instanceCount;
+
+	GeometryArena* arena;
+	GeometryAllocation allocation;
+
+	void bindInstanceAttributes();
 };
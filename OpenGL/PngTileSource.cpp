@@ -0,0 +1,101 @@
+#include <stdio.h>
+
+#include "PngTileSource.h"
+#include "stb_image.h"
+
+PngTileSource::PngTileSource()
+{
+	fileLocation = "";
+	width = 0;
+	height = 0;
+	nChannels = 0;
+	imageData = nullptr;
+}
+
+PngTileSource::PngTileSource(const char* fileLoc)
+{
+	fileLocation = fileLoc;
+	width = 0;
+	height = 0;
+	nChannels = 0;
+	imageData = nullptr;
+}
+
+bool PngTileSource::open()
+{
+	// Only the header is read here
+	if (!stbi_info(fileLocation.c_str(), &width, &height, &nChannels))
+	{
+		printf("Failed to open heightmap: %s\n", fileLocation.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+int PngTileSource::getWidth()
+{
+	return width;
+}
+
+int PngTileSource::getHeight()
+{
+	return height;
+}
+
+bool PngTileSource::readRegion(unsigned int firstRow, unsigned int firstCol, unsigned int numRows, unsigned int numCols,
+	std::vector<float>& samples)
+{
+	if (!imageData)
+	{
+		// This runs on the loader thread while the render thread reads width and height,
+		// so the decode's dimensions go into locals and are only compared against open's
+		int loadedWidth, loadedHeight, loadedChannels;
+
+		// 16-bit maps keep their precision; 8-bit ones come back as value * 257
+		unsigned short* loaded = stbi_load_16(fileLocation.c_str(), &loadedWidth, &loadedHeight, &loadedChannels, 0);
+
+		if (!loaded)
+		{
+			printf("Failed to load heightmap: %s\n", fileLocation.c_str());
+			return false;
+		}
+
+		if (loadedWidth != width || loadedHeight != height || loadedChannels != nChannels)
+		{
+			printf("Heightmap changed since it was opened: %s\n", fileLocation.c_str());
+			stbi_image_free(loaded);
+			return false;
+		}
+
+		imageData = loaded;
+	}
+
+	if (firstRow + numRows > (unsigned int)height || firstCol + numCols > (unsigned int)width)
+	{
+		return false;
+	}
+
+	samples.resize((size_t)numRows * numCols);
+
+	for (unsigned int i = 0; i < numRows; i++)
+	{
+		const unsigned short* texel = imageData + ((size_t)(firstRow + i) * width + firstCol) * nChannels;
+
+		for (unsigned int j = 0; j < numCols; j++, texel += nChannels)
+		{
+			samples[(size_t)i * numCols + j] = texel[0] / 257.0f;
+		}
+	}
+
+	return true;
+}
+
+PngTileSource::~PngTileSource()
+{
+	if (imageData)
+	{
+		stbi_image_free(imageData);
+		imageData = nullptr;
+	}
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <string>
+
+#include "HeightmapTileSource.h"
+
+// Serves tiles out of a PNG heightmap. PNGs can't be decoded a piece at a time,
+// so the whole image is decoded on the loader thread the first time a tile is read.
+class PngTileSource : public HeightmapTileSource
+{
+public:
+	PngTileSource();
+	PngTileSource(const char* fileLoc);
+
+	bool open();
+	int getWidth();
+	int getHeight();
+
+	bool readRegion(unsigned int firstRow, unsigned int firstCol, unsigned int numRows, unsigned int numCols,
+		std::vector<float>& samples);
+
+	~PngTileSource();
+
+private:
+	std::string fileLocation;
+	int width, height, nChannels;
+	unsigned short* imageData;
+};
@@ -0,0 +1,161 @@
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include "ProgramBinaryCache.h"
+#include "Hash.h"
+#include "MappedFile.h"
+
+static_assert(sizeof(ProgramBinaryHeader) == 32, "ProgramBinaryHeader must match the file layout");
+
+ProgramBinaryCache::ProgramBinaryCache()
+{
+	fileLocation = "";
+	key = 0;
+}
+
+ProgramBinaryCache::ProgramBinaryCache(const char* fileLoc, uint64_t binaryKey)
+{
+	fileLocation = fileLoc;
+	key = binaryKey;
+}
+
+bool ProgramBinaryCache::isSupported()
+{
+	if (!GLEW_VERSION_4_1 && !GLEW_ARB_get_program_binary)
+	{
+		return false;
+	}
+
+	GLint formatCount = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+	return formatCount > 0;
+}
+
+std::string ProgramBinaryCache::getDriverString()
+{
+	const char* vendor = (const char*)glGetString(GL_VENDOR);
+	const char* renderer = (const char*)glGetString(GL_RENDERER);
+	const char* version = (const char*)glGetString(GL_VERSION);
+
+	std::string driver;
+	driver += vendor ? vendor : "";
+	driver += "\n";
+	driver += renderer ? renderer : "";
+	driver += "\n";
+	driver += version ? version : "";
+	return driver;
+}
+
+uint64_t ProgramBinaryCache::computeKey(const std::string& vertexCode, const std::string& fragmentCode)
+{
+	std::string driver = getDriverString();
+
+	// The separators keep text moving from one string to the next from giving the same hash
+	const char separator = '\0';
+	uint64_t hash = FNV_OFFSET_BASIS;
+	hash = hashBytes(hash, vertexCode.data(), vertexCode.size());
+	hash = hashBytes(hash, &separator, 1);
+	hash = hashBytes(hash, fragmentCode.data(), fragmentCode.size());
+	hash = hashBytes(hash, &separator, 1);
+	hash = hashBytes(hash, driver.data(), driver.size());
+	hash = hashBytes(hash, &PROGRAM_BINARY_VERSION, sizeof(PROGRAM_BINARY_VERSION));
+	return hash;
+}
+
+bool ProgramBinaryCache::load(Shader& shader)
+{
+	MappedFile file;
+	if (!file.open(fileLocation.c_str()))
+	{
+		return false;
+	}
+
+	if (file.getSize() < sizeof(ProgramBinaryHeader))
+	{
+		return false;
+	}
+
+	ProgramBinaryHeader header;
+	memcpy(&header, file.getData(), sizeof(header));
+
+	if (memcmp(header.magic, PROGRAM_BINARY_MAGIC, 4) != 0 || header.version != PROGRAM_BINARY_VERSION || header.key != key ||
+		sizeof(ProgramBinaryHeader) + (size_t)header.driverLength + header.binaryLength != file.getSize())
+	{
+		return false;
+	}
+
+	// The key already covers the driver, but comparing it costs nothing next to a compile
+	std::string driver = getDriverString();
+	const char* savedDriver = (const char*)file.getData() + sizeof(ProgramBinaryHeader);
+	if (header.driverLength != driver.size() || memcmp(savedDriver, driver.data(), driver.size()) != 0)
+	{
+		return false;
+	}
+
+	const unsigned char* binary = file.getData() + sizeof(ProgramBinaryHeader) + header.driverLength;
+	if (!shader.CreateFromBinary(header.binaryFormat, binary, header.binaryLength))
+	{
+		printf("Program binary rejected by the driver: %s\n", fileLocation.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+bool ProgramBinaryCache::save(Shader& shader)
+{
+	GLenum binaryFormat = 0;
+	std::vector<unsigned char> binary;
+	if (!shader.getBinary(binaryFormat, binary))
+	{
+		return false;
+	}
+
+	std::string driver = getDriverString();
+
+	ProgramBinaryHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, PROGRAM_BINARY_MAGIC, 4);
+	header.version = PROGRAM_BINARY_VERSION;
+	header.key = key;
+	header.binaryFormat = binaryFormat;
+	header.binaryLength = (uint32_t)binary.size();
+	header.driverLength = (uint32_t)driver.size();
+
+	// Written next to the real file first, so a crash never leaves half a binary behind
+	std::string tempLocation = fileLocation + ".tmp";
+	FILE* output = fopen(tempLocation.c_str(), "wb");
+	if (!output)
+	{
+		printf("Failed to create program binary: %s\n", fileLocation.c_str());
+		return false;
+	}
+
+	bool writeFailed = fwrite(&header, sizeof(header), 1, output) != 1 ||
+		fwrite(driver.data(), 1, driver.size(), output) != driver.size() ||
+		fwrite(&binary[0], 1, binary.size(), output) != binary.size();
+	writeFailed = fclose(output) != 0 || writeFailed;
+
+	if (writeFailed)
+	{
+		printf("Failed to write program binary: %s\n", fileLocation.c_str());
+		remove(tempLocation.c_str());
+		return false;
+	}
+
+	// rename won't replace an existing file on Windows
+	remove(fileLocation.c_str());
+	if (rename(tempLocation.c_str(), fileLocation.c_str()) != 0)
+	{
+		printf("Failed to write program binary: %s\n", fileLocation.c_str());
+		remove(tempLocation.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+ProgramBinaryCache::~ProgramBinaryCache()
+{
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+#include <GL\glew.h>
+
+#include "Shader.h"
+
+/*
+	Program binary file (.programbin), native endian:
+
+	ProgramBinaryHeader
+	char driver[driverLength]     GL_VENDOR, GL_RENDERER and GL_VERSION the binary was made with
+	unsigned char binary[binaryLength]
+*/
+struct ProgramBinaryHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint64_t key;
+	uint32_t binaryFormat;
+	uint32_t binaryLength;
+	uint32_t driverLength;
+	uint32_t reserved;
+};
+
+const char PROGRAM_BINARY_MAGIC[4] = { 'P', 'B', 'N', '1' };
+
+// Bumped whenever the file layout changes
+const uint32_t PROGRAM_BINARY_VERSION = 1;
+
+// Saves linked programs with glGetProgramBinary so later runs can skip compiling and linking.
+// Binaries are keyed by a hash of the shader sources and the driver, since a driver
+// update or a different GPU can't load them. The driver may still reject a binary,
+// in which case load fails and the program has to be built from source.
+class ProgramBinaryCache
+{
+public:
+	ProgramBinaryCache();
+	ProgramBinaryCache(const char* fileLoc, uint64_t binaryKey);
+
+	// Needs GL 4.1 or ARB_get_program_binary, and a driver offering at least one binary format
+	static bool isSupported();
+	static uint64_t computeKey(const std::string& vertexCode, const std::string& fragmentCode);
+
+	// Creates shader's program from the saved binary. Fails if the file is missing, damaged,
+	// was saved with a different key or driver, or the driver won't take it.
+	bool load(Shader& shader);
+	// Writes shader's linked program, moving it into place once it's complete
+	bool save(Shader& shader);
+
+	~ProgramBinaryCache();
+
+private:
+	std::string fileLocation;
+	uint64_t key;
+
+	static std::string getDriverString();
+};
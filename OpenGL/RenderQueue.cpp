@@ -0,0 +1,296 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <glm\gtc\type_ptr.hpp>
+
+#include "RenderQueue.h"
+
+const int RENDER_KEY_SHADER_BITS = 8;
+const int RENDER_KEY_TEXTURE_BITS = 12;
+const int RENDER_KEY_MATERIAL_BITS = 12;
+const int RENDER_KEY_DEPTH_BITS = 24;
+
+const int RENDER_KEY_MATERIAL_SHIFT = RENDER_KEY_DEPTH_BITS;
+const int RENDER_KEY_TEXTURE_SHIFT = RENDER_KEY_MATERIAL_SHIFT + RENDER_KEY_MATERIAL_BITS;
+const int RENDER_KEY_SHADER_SHIFT = RENDER_KEY_TEXTURE_SHIFT + RENDER_KEY_TEXTURE_BITS;
+const int RENDER_KEY_PASS_SHIFT = RENDER_KEY_SHADER_SHIFT + RENDER_KEY_SHADER_BITS;
+
+RenderQueue::RenderQueue()
+{
+	eye = glm::vec3(0.0f);
+	depthRange = 1.0f;
+	defaultTextureCreated = false;
+	defaultMaterial = Material();
+	memset(&unsortedStats, 0, sizeof(unsortedStats));
+	memset(&sortedStats, 0, sizeof(sortedStats));
+}
+
+void RenderQueue::begin(glm::vec3 eyePosition, GLfloat farPlane)
+{
+	commands.clear();
+	keys.clear();
+
+	eye = eyePosition;
+	depthRange = farPlane > 0.0f ? farPlane : 1.0f;
+}
+
+unsigned int RenderQueue::getId(std::vector<const void*>& ids, const void* object)
+{
+	// 0 is kept for "no object"
+	if (!object)
+	{
+		return 0;
+	}
+
+	// Only a handful of shaders, textures and materials, so a linear search is fine
+	for (size_t i = 0; i < ids.size(); i++)
+	{
+		if (ids[i] == object)
+		{
+			return (unsigned int)i + 1;
+		}
+	}
+
+	ids.push_back(object);
+	return (unsigned int)ids.size();
+}
+
+void RenderQueue::add(RenderPass pass, Mesh* mesh, Shader* shader, Texture* texture, Material* material, const glm::mat4& model,
+	const glm::mat4& mvp, const glm::mat3& normalMatrix)
+{
+	if (!texture)
+	{
+		if (!defaultTextureCreated)
+		{
+			defaultTexture.CreatePlaceholder();
+			defaultTextureCreated = true;
+		}
+		texture = &defaultTexture;
+	}
+	if (!material)
+	{
+		material = &defaultMaterial;
+	}
+
+	RenderCommand command;
+	command.mesh = mesh;
+	command.shader = shader;
+	command.texture = texture;
+	command.material = material;
+	command.model = model;
+	command.mvp = mvp;
+	command.normalMatrix = normalMatrix;
+	commands.push_back(command);
+
+	// Distance to the model's origin, quantized to the depth field
+	const uint64_t maxDepth = (1ull << RENDER_KEY_DEPTH_BITS) - 1;
+	GLfloat distance = glm::length(glm::vec3(model[3]) - eye) / depthRange;
+	distance = glm::clamp(distance, 0.0f, 1.0f);
+
+	uint64_t depth = (uint64_t)(distance * maxDepth);
+	if (pass == RENDER_PASS_TRANSPARENT)
+	{
+		depth = maxDepth - depth;
+	}
+
+	uint64_t shaderId = getId(shaderIds, shader) & ((1ull << RENDER_KEY_SHADER_BITS) - 1);
+	uint64_t textureId = getId(textureIds, texture) & ((1ull << RENDER_KEY_TEXTURE_BITS) - 1);
+	uint64_t materialId = getId(materialIds, material) & ((1ull << RENDER_KEY_MATERIAL_BITS) - 1);
+
+	keys.push_back(((uint64_t)pass << RENDER_KEY_PASS_SHIFT) |
+		(shaderId << RENDER_KEY_SHADER_SHIFT) |
+		(textureId << RENDER_KEY_TEXTURE_SHIFT) |
+		(materialId << RENDER_KEY_MATERIAL_SHIFT) |
+		depth);
+}
+
+void RenderQueue::sort()
+{
+	size_t count = keys.size();
+
+	sortKeys.assign(keys.begin(), keys.end());
+	scratchKeys.resize(count);
+	order.resize(count);
+	scratchOrder.resize(count);
+
+	for (size_t i = 0; i < count; i++)
+	{
+		order[i] = (uint32_t)i;
+	}
+
+	// Least significant digit first, a byte at a time. Each pass is stable, so
+	// draws with equal keys stay in the order they were added.
+	for (int shift = 0; shift < 64; shift += 8)
+	{
+		size_t histogram[256] = { 0 };
+
+		for (size_t i = 0; i < count; i++)
+		{
+			histogram[(sortKeys[i] >> shift) & 0xFF]++;
+		}
+
+		// Every key has the same byte here (most of the pass and id bytes), nothing to move
+		if (histogram[(sortKeys[0] >> shift) & 0xFF] == count)
+		{
+			continue;
+		}
+
+		size_t offset = 0;
+		for (int digit = 0; digit < 256; digit++)
+		{
+			size_t digitCount = histogram[digit];
+			histogram[digit] = offset;
+			offset += digitCount;
+		}
+
+		for (size_t i = 0; i < count; i++)
+		{
+			size_t destination = histogram[(sortKeys[i] >> shift) & 0xFF]++;
+			scratchKeys[destination] = sortKeys[i];
+			scratchOrder[destination] = order[i];
+		}
+
+		sortKeys.swap(scratchKeys);
+		order.swap(scratchOrder);
+	}
+}
+
+void RenderQueue::countStateChanges(const uint32_t* drawOrder, RenderQueueStats& stats)
+{
+	memset(&stats, 0, sizeof(stats));
+
+	Shader* shader = nullptr;
+	Texture* texture = nullptr;
+	Material* material = nullptr;
+
+	for (size_t i = 0; i < commands.size(); i++)
+	{
+		const RenderCommand& command = commands[drawOrder ? drawOrder[i] : i];
+
+		if (command.shader != shader)
+		{
+			shader = command.shader;
+			stats.shaderChanges++;
+
+			// Material uniforms belong to the program, so they have to be set again
+			material = nullptr;
+		}
+		if (command.texture != texture)
+		{
+			texture = command.texture;
+			stats.textureChanges++;
+		}
+		if (command.material != material)
+		{
+			material = command.material;
+			stats.materialChanges++;
+		}
+
+		stats.draws++;
+	}
+}
+
+void RenderQueue::submit()
+{
+	if (commands.empty())
+	{
+		memset(&unsortedStats, 0, sizeof(unsortedStats));
+		memset(&sortedStats, 0, sizeof(sortedStats));
+		return;
+	}
+
+	// What the draws would have cost without sorting
+	countStateChanges(nullptr, unsortedStats);
+
+	sort();
+
+	memset(&sortedStats, 0, sizeof(sortedStats));
+
+	Shader* shader = nullptr;
+	Texture* texture = nullptr;
+	Material* material = nullptr;
+
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		RenderCommand& command = commands[order[i]];
+
+		if (command.shader != shader)
+		{
+			shader = command.shader;
+			shader->useShader();
+			sortedStats.shaderChanges++;
+
+			material = nullptr;
+		}
+		if (command.texture != texture)
+		{
+			texture = command.texture;
+			texture->UseTexture();
+			sortedStats.textureChanges++;
+		}
+		if (command.material != material)
+		{
+			material = command.material;
+			material->UseMaterial(shader->getUniformLocation(UNIFORM_SPECULAR_INTENSITY), shader->getUniformLocation(UNIFORM_SHININESS));
+			sortedStats.materialChanges++;
+		}
+
+		glUniformMatrix4fv(shader->getUniformLocation(UNIFORM_MODEL), 1, GL_FALSE, glm::value_ptr(command.model));
+		glUniformMatrix4fv(shader->getUniformLocation(UNIFORM_MVP), 1, GL_FALSE, glm::value_ptr(command.mvp));
+		glUniformMatrix3fv(shader->getUniformLocation(UNIFORM_NORMAL_MATRIX), 1, GL_FALSE, glm::value_ptr(command.normalMatrix));
+		command.mesh->renderMesh();
+		sortedStats.draws++;
+	}
+}
+
+unsigned int RenderQueue::getDrawCount()
+{
+	return (unsigned int)commands.size();
+}
+
+RenderQueueStats RenderQueue::getUnsortedStats()
+{
+	return unsortedStats;
+}
+
+RenderQueueStats RenderQueue::getSortedStats()
+{
+	return sortedStats;
+}
+
+void RenderQueue::reportStats()
+{
+	unsigned int unsortedTotal = unsortedStats.shaderChanges + unsortedStats.textureChanges + unsortedStats.materialChanges;
+	unsigned int sortedTotal = sortedStats.shaderChanges + sortedStats.textureChanges + sortedStats.materialChanges;
+
+	printf("Render queue: %u draws, %u state changes in added order, %u sorted "
+		"(shader %u -> %u, texture %u -> %u, material %u -> %u)\n",
+		sortedStats.draws, unsortedTotal, sortedTotal,
+		unsortedStats.shaderChanges, sortedStats.shaderChanges,
+		unsortedStats.textureChanges, sortedStats.textureChanges,
+		unsortedStats.materialChanges, sortedStats.materialChanges);
+}
+
+void RenderQueue::clear()
+{
+	commands.clear();
+	keys.clear();
+	sortKeys.clear();
+	scratchKeys.clear();
+	order.clear();
+	scratchOrder.clear();
+	shaderIds.clear();
+	textureIds.clear();
+	materialIds.clear();
+
+	if (defaultTextureCreated)
+	{
+		defaultTexture.ClearTexture();
+		defaultTextureCreated = false;
+	}
+}
+
+RenderQueue::~RenderQueue()
+{
+	clear();
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include <GL\glew.h>
+
+#include <glm\glm.hpp>
+
+#include "Mesh.h"
+#include "Shader.h"
+#include "Texture.h"
+#include "Material.h"
+
+// Opaque draws go first, nearest first. Transparent draws go last, furthest first.
+enum RenderPass
+{
+	RENDER_PASS_OPAQUE = 0,
+	RENDER_PASS_TRANSPARENT = 1
+};
+
+// State changes made while submitting, and what the same draws would have cost in the order they were added
+struct RenderQueueStats
+{
+	unsigned int draws;
+	unsigned int shaderChanges;
+	unsigned int textureChanges;
+	unsigned int materialChanges;
+};
+
+// Collects a frame's mesh draws, sorts them by a packed 64-bit key and submits them
+// so the shader, texture and material only change when they have to.
+// Key layout, most significant first: pass (8 bits), shader (8), texture (12), material (12), depth (24).
+class RenderQueue
+{
+public:
+	RenderQueue();
+
+	// Clears the previous frame's draws. Depth is the distance from eyePosition, out to farPlane.
+	void begin(glm::vec3 eyePosition, GLfloat farPlane);
+	// A null texture or material draws with the queue's defaults: a white 1x1 texture and a
+	// material without specular highlights. Nothing is inherited from the previous draw.
+	// mvp and normalMatrix are the object's projection * view * model and model's inverse transpose.
+	void add(RenderPass pass, Mesh* mesh, Shader* shader, Texture* texture, Material* material, const glm::mat4& model,
+		const glm::mat4& mvp, const glm::mat3& normalMatrix);
+	// Sorts and draws everything added since begin
+	void submit();
+
+	unsigned int getDrawCount();
+	RenderQueueStats getUnsortedStats();
+	RenderQueueStats getSortedStats();
+	void reportStats();
+
+	void clear();
+
+	~RenderQueue();
+
+private:
+	struct RenderCommand
+	{
+		Mesh* mesh;
+		Shader* shader;
+		Texture* texture;
+		Material* material;
+		glm::mat4 model;
+		glm::mat4 mvp;
+		glm::mat3 normalMatrix;
+	};
+
+	std::vector<RenderCommand> commands;
+	std::vector<uint64_t> keys;
+
+	// Radix sort works on (key, command) pairs, ping-ponging between the two arrays
+	std::vector<uint64_t> sortKeys, scratchKeys;
+	std::vector<uint32_t> order, scratchOrder;
+
+	// Small ids for the key. Pointers are compared when submitting, so an id that
+	// overflows its field only costs sort quality, never correctness.
+	std::vector<const void*> shaderIds, textureIds, materialIds;
+
+	glm::vec3 eye;
+	GLfloat depthRange;
+
+	// Stand-ins for null textures and materials. The texture is created on first use,
+	// since the queue can be constructed before the GL context.
+	Texture defaultTexture;
+	bool defaultTextureCreated;
+	Material defaultMaterial;
+
+	RenderQueueStats unsortedStats, sortedStats;
+
+	static unsigned int getId(std::vector<const void*>& ids, const void* object);
+	void sort();
+	void countStateChanges(const uint32_t* drawOrder, RenderQueueStats& stats);
+};
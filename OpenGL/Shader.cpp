@@ -1,11 +1,37 @@
+#include <utility>
+
 #include "Shader.h"
+#include "UniformBuffer.h"
+#include "IndirectDrawList.h"
+
+// Shared uniform blocks and the binding points their buffers are attached to
+static const struct
+{
+	const char* name;
+	GLuint binding;
+} uniformBlockBindings[] =
+{
+	{ "FrameData", FRAME_UNIFORM_BINDING },
+	{ "SceneData", SCENE_UNIFORM_BINDING }
+};
+
+// Texture units of the samplers. Set once when a program links: samplers left on
+// unit 0 together would mix sampler types on one unit, which GL doesn't allow.
+static const struct
+{
+	const char* name;
+	GLint unit;
+} samplerUnits[] =
+{
+	{ "theTexture", 0 },
+	{ "drawData", (GLint)INDIRECT_DRAW_DATA_UNIT }
+};
 
 Shader::Shader()
 {
 	shaderID = 0;
-	uniformModel = 0;
-	uniformProjection = 0;
-	uniformView = 0;
+	vertexShaderID = 0;
+	fragmentShaderID = 0;
 }
 
 void Shader::CreateFromString(const char* vertexCode, const char* fragmentCode)
@@ -13,6 +39,55 @@ void Shader::CreateFromString(const char* vertexCode, const char* fragmentCode)
 	compileShader(vertexCode, fragmentCode);
 }
 
+bool Shader::CreateFromBinary(GLenum binaryFormat, const void* binary, GLsizei length)
+{
+	shaderID = glCreateProgram();
+
+	if (!shaderID)
+	{
+		printf("Failed to create shader\n");
+		return false;
+	}
+
+	glProgramBinary(shaderID, binaryFormat, binary, length);
+
+	// A driver update can make old binaries unusable, the caller falls back to compiling the source
+	GLint result = 0;
+	glGetProgramiv(shaderID, GL_LINK_STATUS, &result);
+
+	if (!result)
+	{
+		glDeleteProgram(shaderID);
+		shaderID = 0;
+		return false;
+	}
+
+	reflectUniforms();
+	return true;
+}
+
+bool Shader::getBinary(GLenum& binaryFormat, std::vector<unsigned char>& binary)
+{
+	if (!shaderID)
+	{
+		return false;
+	}
+
+	GLint length = 0;
+	glGetProgramiv(shaderID, GL_PROGRAM_BINARY_LENGTH, &length);
+
+	if (length <= 0)
+	{
+		return false;
+	}
+
+	binary.resize(length);
+	glGetProgramBinary(shaderID, length, &length, &binaryFormat, &binary[0]);
+	binary.resize(length);
+
+	return length > 0;
+}
+
 void Shader::CreateFromFiles(const char* vertexLocation, const char* fragmentLocation)
 {
 	std::string vertexString = ReadFile(vertexLocation);
@@ -45,6 +120,26 @@ std::string Shader::ReadFile(const char* fileLocation)
 }
 
 void Shader::compileShader(const char* vertexCode, const char* fragmentCode)
+{
+	beginCompile(vertexCode, fragmentCode);
+	finishCompile();
+}
+
+void Shader::enableParallelCompile()
+{
+	// Let the driver use as many threads as it likes. Compiles then run in the background
+	// and isCompileComplete can be polled instead of waiting.
+	if (GLEW_KHR_parallel_shader_compile)
+	{
+		glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+	}
+	else if (GLEW_ARB_parallel_shader_compile)
+	{
+		glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+	}
+}
+
+void Shader::beginCompile(const char* vertexCode, const char* fragmentCode)
 {
 	// Creating the prog
 	shaderID = glCreateProgram();
@@ -59,12 +154,47 @@ void Shader::compileShader(const char* vertexCode, const char* fragmentCode)
 	// Adding shader to the program
 	// Pass in the prog, string vShader
 	// Indicate the type of shader
-	addShader(shaderID, vertexCode, GL_VERTEX_SHADER);
+	vertexShaderID = addShader(shaderID, vertexCode, GL_VERTEX_SHADER);
 
 	// Adding shader to the program
 	// Pass in the prog, string fShader
 	// Indicate the type of shader
-	addShader(shaderID, fragmentCode, GL_FRAGMENT_SHADER);
+	fragmentShaderID = addShader(shaderID, fragmentCode, GL_FRAGMENT_SHADER);
+
+	// Lets ProgramBinaryCache save the program once it's linked
+	if (GLEW_VERSION_4_1 || GLEW_ARB_get_program_binary)
+	{
+		glProgramParameteri(shaderID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
+
+	// Nothing is checked until finishCompile, so the driver can compile and link in the background
+	glLinkProgram(shaderID);
+}
+
+bool Shader::isCompileComplete()
+{
+	if (!shaderID || (!vertexShaderID && !fragmentShaderID))
+	{
+		return true;
+	}
+
+	// Without the extension there's no way to ask, so finishCompile just waits
+	if (!GLEW_KHR_parallel_shader_compile && !GLEW_ARB_parallel_shader_compile)
+	{
+		return true;
+	}
+
+	GLint complete = 0;
+	glGetProgramiv(shaderID, GL_COMPLETION_STATUS_KHR, &complete);
+	return complete != 0;
+}
+
+bool Shader::finishCompile()
+{
+	if (!shaderID)
+	{
+		return false;
+	}
 
 	#pragma region ErrorChecking
 	// Getting error codes from the creation of the shaders
@@ -72,17 +202,28 @@ void Shader::compileShader(const char* vertexCode, const char* fragmentCode)
 	GLchar eLog[1024] = { 0 }; // logging the error
 
 	// Checking if the program is linked correctly
-	glLinkProgram(shaderID);
 	glGetProgramiv(shaderID, GL_LINK_STATUS, &result); // get the info. Check if the prog is linked
 
 	// Check if the result is false.
 	if (!result)
 	{
+		// A stage that failed to compile is the usual reason, so report those first
+		printCompileErrors(vertexShaderID, GL_VERTEX_SHADER);
+		printCompileErrors(fragmentShaderID, GL_FRAGMENT_SHADER);
+		deleteStages();
+
 		glGetProgramInfoLog(shaderID, sizeof(eLog), NULL, eLog);
 		printf("Error linking program: '%s'\n", eLog);
-		return;
+		return false;
 	}
 
+	// The linked program keeps everything it needs from the stages
+	deleteStages();
+
+	// Uniforms are looked up before validating, since validation depends on the current GL
+	// state and a linked program is still usable when it fails
+	reflectUniforms();
+
 	// Validate the program/
 	// Checking if openGL was setup correctly for the shader
 	glValidateProgram(shaderID);
@@ -92,70 +233,118 @@ void Shader::compileShader(const char* vertexCode, const char* fragmentCode)
 	{
 		glGetProgramInfoLog(shaderID, sizeof(eLog), NULL, eLog);
 		printf("Error validating program: '%s'\n", eLog);
-		return;
 	}
 	#pragma endregion
 
-	uniformModel = glGetUniformLocation(shaderID, "model");
-	uniformProjection = glGetUniformLocation(shaderID, "projection");
-	uniformView = glGetUniformLocation(shaderID, "view");
-	uniformAmbientColour = glGetUniformLocation(shaderID, "directionalLight.colour");
-	uniformAmbientIntensity = glGetUniformLocation(shaderID, "directionalLight.ambientIntensity");
-	uniformDirection = glGetUniformLocation(shaderID, "directionalLight.direction");
-	uniformDiffuseIntensity = glGetUniformLocation(shaderID, "directionalLight.diffuseIntensity");
-	uniformSpecularIntensity = glGetUniformLocation(shaderID, "material.specularIntensity");
-	uniformShininess = glGetUniformLocation(shaderID, "material.shininess");
-	uniformEyePosition = glGetUniformLocation(shaderID, "eyePosition");
+	return true;
 }
 
-GLuint Shader::getProjectionLocation()
+void Shader::swapProgram(Shader& other)
 {
-	return uniformProjection;
+	std::swap(shaderID, other.shaderID);
+	std::swap(vertexShaderID, other.vertexShaderID);
+	std::swap(fragmentShaderID, other.fragmentShaderID);
+	uniformLocations.swap(other.uniformLocations);
 }
 
-GLuint Shader::getModelLocation()
+void Shader::reflectUniforms()
 {
-	return uniformModel;
-}
+	// Camera and lighting come from the shared uniform buffers rather than per-program uniforms
+	GLint blockCount = 0;
+	glGetProgramiv(shaderID, GL_ACTIVE_UNIFORM_BLOCKS, &blockCount);
 
-GLuint Shader::getViewLocation()
-{
-	return uniformView;
-}
+	for (GLint block = 0; block < blockCount; block++)
+	{
+		GLchar blockName[64] = { 0 };
+		glGetActiveUniformBlockName(shaderID, block, sizeof(blockName), NULL, blockName);
+
+		for (size_t i = 0; i < sizeof(uniformBlockBindings) / sizeof(uniformBlockBindings[0]); i++)
+		{
+			if (strcmp(blockName, uniformBlockBindings[i].name) == 0)
+			{
+				glUniformBlockBinding(shaderID, block, uniformBlockBindings[i].binding);
+			}
+		}
+	}
 
-GLuint Shader::getAmbientIntensityLocation()
-{
-	return uniformAmbientIntensity;
-}
+	for (size_t i = 0; i < sizeof(samplerUnits) / sizeof(samplerUnits[0]); i++)
+	{
+		GLint location = glGetUniformLocation(shaderID, samplerUnits[i].name);
+		if (location >= 0)
+		{
+			// Sampler values belong to the program, so it has to be bound to set them
+			GLStateCache::useProgram(shaderID);
+			glUniform1i(location, samplerUnits[i].unit);
+		}
+	}
 
-GLuint Shader::getAmbientColourLocation()
-{
-	return uniformAmbientColour;
-}
+	// Every active uniform gets a slot under its interned name, whatever the shader declares
+	uniformLocations.assign(UniformNames::getCount(), -1);
 
-GLuint Shader::getDiffuseIntensityLocation()
-{
-	return uniformDiffuseIntensity;
-}
+	GLint uniformCount = 0;
+	GLint maxNameLength = 0;
+	glGetProgramiv(shaderID, GL_ACTIVE_UNIFORMS, &uniformCount);
+	glGetProgramiv(shaderID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
 
-GLuint Shader::getDirectionLocation()
-{
-	return uniformDirection;
-}
+	std::vector<GLchar> nameBuffer(maxNameLength + 1, '\0');
 
-GLuint Shader::getSpecularIntensityLocation()
-{
-	return uniformSpecularIntensity;
+	for (GLint uniform = 0; uniform < uniformCount; uniform++)
+	{
+		GLint size = 0;
+		GLenum type = 0;
+		glGetActiveUniform(shaderID, uniform, (GLsizei)nameBuffer.size(), NULL, &size, &type, &nameBuffer[0]);
+
+		std::string name = &nameBuffer[0];
+		GLint location = glGetUniformLocation(shaderID, name.c_str());
+
+		// Uniform block members have no location, they're set through UniformBuffer
+		if (location < 0)
+		{
+			continue;
+		}
+
+		// Arrays of plain types are listed once, as name[0]. Each element is filed separately,
+		// and the bare name means the first element the same way it does for glGetUniformLocation.
+		size_t length = name.size();
+		if (length > 3 && name.compare(length - 3, 3, "[0]") == 0)
+		{
+			std::string baseName = name.substr(0, length - 3);
+			setUniformLocation(baseName, location);
+
+			for (GLint element = 0; element < size; element++)
+			{
+				std::string elementName = baseName + "[" + std::to_string(element) + "]";
+				setUniformLocation(elementName, glGetUniformLocation(shaderID, elementName.c_str()));
+			}
+		}
+		else
+		{
+			setUniformLocation(name, location);
+		}
+	}
 }
 
-GLuint Shader::getShininessLocation()
+void Shader::setUniformLocation(const std::string& name, GLint location)
 {
-	return uniformShininess;
+	UniformId id = UniformNames::intern(name);
+
+	if (id >= uniformLocations.size())
+	{
+		uniformLocations.resize(id + 1, -1);
+	}
+
+	uniformLocations[id] = location;
 }
 
-GLuint Shader::getEyePositionLocation()
+GLint Shader::getUniformLocation(UniformId id)
 {
-	return uniformEyePosition;
+	// Names this program doesn't use, including ones interned after it linked, are -1 and ignored by glUniform*
+	if (id >= uniformLocations.size())
+	{
+		return -1;
+	}
+
+	return uniformLocations[id];
 }
 
 void Shader::useShader()
@@ -165,23 +354,23 @@ void Shader::useShader()
 		printf("Failed to create shader\n");
 		return;
 	}
-	glUseProgram(shaderID);
+	GLStateCache::useProgram(shaderID);
 }
 
 void Shader::clearShader()
 {
 	if (shaderID != 0)
 	{
+		deleteStages();
 		glDeleteProgram(shaderID);
+		GLStateCache::forgetProgram(shaderID);
 		shaderID = 0;
 	}
 
-	uniformModel = 0;
-	uniformProjection = 0;
-
+	uniformLocations.clear();
 }
 
-void Shader::addShader(GLuint theProgram, const char* shaderCode, GLenum shaderType)
+GLuint Shader::addShader(GLuint theProgram, const char* shaderCode, GLenum shaderType)
 {
 	GLuint theShader = glCreateShader(shaderType);
 
@@ -195,6 +384,18 @@ void Shader::addShader(GLuint theProgram, const char* shaderCode, GLenum shaderT
 	glShaderSource(theShader, 1, theCode, codeLength);
 	glCompileShader(theShader);
 
+	// Attaching the shader to the program. The compile status is only checked if linking fails.
+	glAttachShader(theProgram, theShader);
+	return theShader;
+}
+
+void Shader::printCompileErrors(GLuint theShader, GLenum shaderType)
+{
+	if (!theShader)
+	{
+		return;
+	}
+
 	#pragma region ErrorCheck
 	GLint result = 0;
 	GLchar eLog[1024] = { 0 };
@@ -205,12 +406,25 @@ void Shader::addShader(GLuint theProgram, const char* shaderCode, GLenum shaderT
 	{
 		glGetShaderInfoLog(theShader, 1024, NULL, eLog);
 		fprintf(stderr, "Error compiling the %d shader: '%s'\n", shaderType, eLog);
-		return;
 	}
 	#pragma endregion
+}
 
-	// Attaching the shader to the program
-	glAttachShader(theProgram, theShader);
+void Shader::deleteStages()
+{
+	GLuint stages[2] = { vertexShaderID, fragmentShaderID };
+
+	for (int i = 0; i < 2; i++)
+	{
+		if (stages[i])
+		{
+			glDetachShader(shaderID, stages[i]);
+			glDeleteShader(stages[i]);
+		}
+	}
+
+	vertexShaderID = 0;
+	fragmentShaderID = 0;
 }
 
 Shader::~Shader()
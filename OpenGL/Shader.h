@@ -4,9 +4,13 @@
 #include <stdio.h>
 #include <iostream>
 #include <fstream>
+#include <vector>
 
 #include <GL/glew.h>
 
+#include "GLStateCache.h"
+#include "UniformNames.h"
+
 class Shader
 {
 
@@ -15,19 +19,32 @@ public:
 
 	void CreateFromString(const char* vertexCode, const char* fragmentCode);
 	void CreateFromFiles(const char* vertexLocation, const char* fragmentLocation);
+	// Starts compiling and linking without waiting for the driver. finishCompile has to be
+	// called before the program is used; isCompileComplete says whether that would block.
+	void beginCompile(const char* vertexCode, const char* fragmentCode);
+	// Always true without KHR_parallel_shader_compile, since the driver can't be asked
+	bool isCompileComplete();
+	// Checks the link, printing any errors, and looks up the uniforms. False only if linking failed;
+	// a validation failure is printed but the program is kept.
+	bool finishCompile();
+
+	// Exchanges programs and uniform locations with other, so everything holding
+	// this Shader draws with other's program from then on
+	void swapProgram(Shader& other);
+
+	// Lets the driver compile on its own threads when KHR_parallel_shader_compile is available
+	static void enableParallelCompile();
+
+	// Loads a program saved by getBinary. Fails, leaving no program, if the driver rejects it.
+	bool CreateFromBinary(GLenum binaryFormat, const void* binary, GLsizei length);
+
+	// The linked program as returned by glGetProgramBinary. Fails if there is no linked program.
+	bool getBinary(GLenum& binaryFormat, std::vector<unsigned char>& binary);
 
 	std::string ReadFile(const char* fileLocation);
 
-	GLuint getProjectionLocation();
-	GLuint getModelLocation();
-	GLuint getViewLocation();
-	GLuint getAmbientIntensityLocation();
-	GLuint getAmbientColourLocation();
-	GLuint getDiffuseIntensityLocation();
-	GLuint getDirectionLocation();
-	GLuint getSpecularIntensityLocation();
-	GLuint getShininessLocation();
-	GLuint getEyePositionLocation();
+	// Location of a uniform by its interned name, -1 if this program doesn't use it
+	GLint getUniformLocation(UniformId id);
 
 	void useShader();
 	void clearShader();
@@ -35,9 +52,15 @@ public:
 	~Shader();
 
 private:
-	GLuint shaderID, uniformProjection, uniformModel, uniformView, uniformEyePosition, uniformAmbientIntensity,
-		   uniformAmbientColour, uniformDiffuseIntensity, uniformDirection, uniformSpecularIntensity, uniformShininess;
+	GLuint shaderID, vertexShaderID, fragmentShaderID;
+
+	// Indexed by UniformId, filled from the program's active uniforms after linking
+	std::vector<GLint> uniformLocations;
 
 	void compileShader(const char* vertexCode, const char* fragmentCode);
-	void addShader(GLuint theProgram, const char* shaderCode, GLenum shaderType);
+	void reflectUniforms();
+	void setUniformLocation(const std::string& name, GLint location);
+	GLuint addShader(GLuint theProgram, const char* shaderCode, GLenum shaderType);
+	void printCompileErrors(GLuint theShader, GLenum shaderType);
+	void deleteStages();
 };
\ No newline at end of file
@@ -0,0 +1,322 @@
+#include <sys/stat.h>
+
+#include "ShaderCache.h"
+#include "ProgramBinaryCache.h"
+
+ShaderCache::ShaderCache()
+{
+	vertexLocation = "";
+	fragmentLocation = "";
+	sourcesRead = false;
+	vertexModified = 0;
+	fragmentModified = 0;
+	binaryCacheEnabled = true;
+	binaryLoadCount = 0;
+}
+
+ShaderCache::ShaderCache(const char* vertexFile, const char* fragmentFile)
+{
+	vertexLocation = vertexFile;
+	fragmentLocation = fragmentFile;
+	sourcesRead = false;
+	vertexModified = 0;
+	fragmentModified = 0;
+	binaryCacheEnabled = true;
+	binaryLoadCount = 0;
+}
+
+void ShaderCache::readSources()
+{
+	Shader reader;
+	vertexSource = reader.ReadFile(vertexLocation.c_str());
+	fragmentSource = reader.ReadFile(fragmentLocation.c_str());
+	sourcesRead = true;
+
+	vertexModified = getModifiedTime(vertexLocation);
+	fragmentModified = getModifiedTime(fragmentLocation);
+}
+
+time_t ShaderCache::getModifiedTime(const std::string& fileLocation)
+{
+	struct stat fileInfo;
+	if (stat(fileLocation.c_str(), &fileInfo) != 0)
+	{
+		return 0;
+	}
+
+	return fileInfo.st_mtime;
+}
+
+std::string ShaderCache::getDefines(unsigned int features)
+{
+	std::string defines;
+
+	if (features & SHADER_TEXTURED)
+	{
+		defines += "#define TEXTURED\n";
+	}
+	if (features & SHADER_LIT)
+	{
+		defines += "#define LIT\n";
+	}
+	if (features & SHADER_SPECULAR)
+	{
+		defines += "#define SPECULAR\n";
+	}
+	if (features & SHADER_TERRAIN)
+	{
+		defines += "#define TERRAIN\n";
+	}
+
+	return defines;
+}
+
+std::string ShaderCache::insertDefines(const std::string& source, const std::string& defines)
+{
+	// #version has to stay the first line, so the defines go straight after it
+	size_t version = source.find("#version");
+	if (version == std::string::npos)
+	{
+		return defines + source;
+	}
+
+	size_t lineEnd = source.find('\n', version);
+	if (lineEnd == std::string::npos)
+	{
+		return source + "\n" + defines;
+	}
+
+	std::string result = source;
+	result.insert(lineEnd + 1, defines);
+	return result;
+}
+
+std::string ShaderCache::getBinaryLocation(unsigned int features)
+{
+	// Shaders/shader.vert with features 11 becomes Shaders/shader.11.programbin
+	std::string path = vertexLocation;
+	size_t dot = path.find_last_of('.');
+
+	if (dot != std::string::npos && path.find_first_of("/\\", dot) == std::string::npos)
+	{
+		path.erase(dot);
+	}
+
+	return path + "." + std::to_string(features) + ".programbin";
+}
+
+Shader* ShaderCache::requestShader(unsigned int features)
+{
+	std::map<unsigned int, Shader*>::iterator found = shaders.find(features);
+	if (found != shaders.end())
+	{
+		return found->second;
+	}
+
+	if (!sourcesRead)
+	{
+		readSources();
+	}
+
+	Shader* shader = new Shader();
+	shaders[features] = shader;
+
+	build(features, shader, shader);
+	return shader;
+}
+
+Shader* ShaderCache::getShader(unsigned int features)
+{
+	Shader* shader = requestShader(features);
+
+	for (size_t i = 0; i < pending.size(); i++)
+	{
+		if (pending[i].shader == shader)
+		{
+			finishCompile(i);
+			break;
+		}
+	}
+
+	return shader;
+}
+
+void ShaderCache::build(unsigned int features, Shader* shader, Shader* target)
+{
+	std::string defines = getDefines(features);
+	std::string vertexCode = insertDefines(vertexSource, defines);
+	std::string fragmentCode = insertDefines(fragmentSource, defines);
+
+	// The key covers the final source with its defines, so editing a shader invalidates its binaries
+	bool useBinaries = binaryCacheEnabled && ProgramBinaryCache::isSupported();
+	std::string binaryLocation = getBinaryLocation(features);
+	uint64_t binaryKey = useBinaries ? ProgramBinaryCache::computeKey(vertexCode, fragmentCode) : 0;
+	ProgramBinaryCache binaryCache(binaryLocation.c_str(), binaryKey);
+
+	// A binary load doesn't compile anything, so it's finished straight away
+	if (useBinaries && binaryCache.load(*shader))
+	{
+		binaryLoadCount++;
+		printf("Loaded shader permutation %u from %s\n", features, binaryLocation.c_str());
+
+		if (target != shader)
+		{
+			target->swapProgram(*shader);
+			delete shader;
+		}
+		return;
+	}
+
+	shader->beginCompile(vertexCode.c_str(), fragmentCode.c_str());
+
+	PendingCompile compile;
+	compile.features = features;
+	compile.shader = shader;
+	compile.target = target;
+	compile.binaryKey = binaryKey;
+	pending.push_back(compile);
+}
+
+bool ShaderCache::finishCompile(size_t index)
+{
+	PendingCompile compile = pending[index];
+	pending.erase(pending.begin() + index);
+
+	bool linked = compile.shader->finishCompile();
+
+	if (compile.target != compile.shader)
+	{
+		if (!linked)
+		{
+			printf("Reloading shader permutation %u failed, keeping the previous program\n", compile.features);
+			delete compile.shader;
+			return false;
+		}
+
+		// compile.shader gets the old program and takes it with it
+		compile.target->swapProgram(*compile.shader);
+		delete compile.shader;
+		printf("Reloaded shader permutation %u\n", compile.features);
+	}
+	else
+	{
+		printf("Compiled shader permutation %u (%u cached)\n", compile.features, (unsigned int)shaders.size());
+	}
+
+	if (linked && compile.binaryKey != 0)
+	{
+		std::string binaryLocation = getBinaryLocation(compile.features);
+		ProgramBinaryCache binaryCache(binaryLocation.c_str(), compile.binaryKey);
+		binaryCache.save(*compile.target);
+	}
+
+	return linked;
+}
+
+bool ShaderCache::update()
+{
+	for (size_t i = 0; i < pending.size();)
+	{
+		if (pending[i].shader->isCompileComplete())
+		{
+			finishCompile(i);
+		}
+		else
+		{
+			i++;
+		}
+	}
+
+	return pending.empty();
+}
+
+void ShaderCache::finishAll()
+{
+	while (!pending.empty())
+	{
+		finishCompile(0);
+	}
+}
+
+bool ShaderCache::checkForChanges()
+{
+	if (!sourcesRead)
+	{
+		return false;
+	}
+
+	time_t vertexTime = getModifiedTime(vertexLocation);
+	time_t fragmentTime = getModifiedTime(fragmentLocation);
+
+	if (vertexTime == vertexModified && fragmentTime == fragmentModified)
+	{
+		return false;
+	}
+
+	// First builds still in flight are finished with the old source, then reloaded like the rest
+	for (size_t i = 0; i < pending.size();)
+	{
+		if (pending[i].target == pending[i].shader)
+		{
+			finishCompile(i);
+		}
+		else
+		{
+			// An earlier reload that hasn't finished yet is out of date now
+			delete pending[i].shader;
+			pending.erase(pending.begin() + i);
+		}
+	}
+
+	readSources();
+	printf("Shader sources changed, rebuilding %u permutation(s)\n", (unsigned int)shaders.size());
+
+	for (std::map<unsigned int, Shader*>::iterator it = shaders.begin(); it != shaders.end(); ++it)
+	{
+		build(it->first, new Shader(), it->second);
+	}
+
+	return true;
+}
+
+unsigned int ShaderCache::getCompiledCount()
+{
+	return (unsigned int)shaders.size();
+}
+
+unsigned int ShaderCache::getBinaryLoadCount()
+{
+	return binaryLoadCount;
+}
+
+void ShaderCache::setBinaryCacheEnabled(bool enabled)
+{
+	binaryCacheEnabled = enabled;
+}
+
+void ShaderCache::clear()
+{
+	for (size_t i = 0; i < pending.size(); i++)
+	{
+		if (pending[i].shader != pending[i].target)
+		{
+			delete pending[i].shader;
+		}
+	}
+	pending.clear();
+
+	for (std::map<unsigned int, Shader*>::iterator it = shaders.begin(); it != shaders.end(); ++it)
+	{
+		delete it->second;
+	}
+	shaders.clear();
+
+	vertexSource.clear();
+	fragmentSource.clear();
+	sourcesRead = false;
+	binaryLoadCount = 0;
+}
+
+ShaderCache::~ShaderCache()
+{
+}
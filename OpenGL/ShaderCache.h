@@ -0,0 +1,93 @@
+#pragma once
+
+#include <stdint.h>
+#include <time.h>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "Shader.h"
+
+// Optional parts of shader.vert and shader.frag. Each one is a #define the source checks with #ifdef.
+enum ShaderFeature
+{
+	SHADER_TEXTURED = 1 << 0,
+	SHADER_LIT = 1 << 1,
+	SHADER_SPECULAR = 1 << 2,
+	SHADER_TERRAIN = 1 << 3
+};
+
+// Builds programs from one vertex and fragment source with different features compiled in.
+// The sources are read once; a permutation is compiled the first time it's asked for
+// and the same Shader is handed back after that. Linked programs are also saved as
+// program binaries next to the vertex shader, so later runs can skip compiling.
+//
+// Compiles are started without waiting and finished by update once the driver is done,
+// so with KHR_parallel_shader_compile they run alongside the rest of startup. When the
+// source files change on disk every permutation is rebuilt the same way and swapped into
+// its existing Shader, so the pointers handed out stay valid.
+class ShaderCache
+{
+public:
+	ShaderCache();
+	ShaderCache(const char* vertexLocation, const char* fragmentLocation);
+
+	// features is a combination of ShaderFeature flags. The Shader can't be drawn with
+	// until update has finished it, or getShader or finishAll is called.
+	Shader* requestShader(unsigned int features);
+	// requestShader, then waits for that permutation to be ready
+	Shader* getShader(unsigned int features);
+
+	// Finishes whatever the driver is done with and swaps in reloaded programs.
+	// True once nothing is left in flight.
+	bool update();
+	// Waits for every compile in flight
+	void finishAll();
+
+	// Starts rebuilding every permutation if either source file has changed since it was read.
+	// A reload that fails to compile keeps the previous program.
+	bool checkForChanges();
+
+	unsigned int getCompiledCount();
+	// How many of the programs came from a saved binary rather than from source
+	unsigned int getBinaryLoadCount();
+
+	// Off always builds from source and never reads or writes binaries
+	void setBinaryCacheEnabled(bool enabled);
+
+	// Deletes every program, so call it while the GL context is still current
+	void clear();
+
+	~ShaderCache();
+
+private:
+	// A program being built. target is the Shader it ends up in: shader itself the first
+	// time a permutation is built, or the Shader already handed out when reloading.
+	struct PendingCompile
+	{
+		unsigned int features;
+		Shader* shader;
+		Shader* target;
+		uint64_t binaryKey;
+	};
+
+	std::string vertexLocation, fragmentLocation;
+	std::string vertexSource, fragmentSource;
+	bool sourcesRead;
+	time_t vertexModified, fragmentModified;
+
+	bool binaryCacheEnabled;
+	unsigned int binaryLoadCount;
+
+	std::map<unsigned int, Shader*> shaders;
+	std::vector<PendingCompile> pending;
+
+	void readSources();
+	void build(unsigned int features, Shader* shader, Shader* target);
+	bool finishCompile(size_t index);
+
+	static time_t getModifiedTime(const std::string& fileLocation);
+	static std::string getDefines(unsigned int features);
+	static std::string insertDefines(const std::string& source, const std::string& defines);
+	std::string getBinaryLocation(unsigned int features);
+};
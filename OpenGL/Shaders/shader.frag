@@ -1,10 +1,15 @@
 #version 330
 
-in vec4 vCol;
+// Compiled in permutations (see ShaderCache):
+// TEXTURED multiplies in theTexture, LIT adds ambient and diffuse light,
+// SPECULAR adds specular highlights on top of LIT.
+
 in vec2 TexCoord;
 in vec3 Normal;
 in float Height;
 in vec3 FragPos;
+flat in int MaterialIndex;
+flat in int TerrainVertex;
 
 out vec4 colour;
 
@@ -22,16 +27,46 @@ struct Material
 	float shininess;
 };
 
+#ifdef TEXTURED
 uniform sampler2D theTexture;
+#endif
 
-uniform DirectionalLight directionalLight;
+// Shared by every program. Must match SceneUniforms and FrameUniforms.
+layout (std140) uniform SceneData
+{
+	DirectionalLight directionalLight;
+};
+
+layout (std140) uniform FrameData
+{
+	mat4 projection;
+	mat4 view;
+	vec3 eyePosition;
+	bool perVertexMatrices;
+};
 
+#ifdef SPECULAR
 uniform Material material;
 
-uniform vec3 eyePosition;
+// Instanced draws pick their material by index. Size must match MAX_INSTANCE_MATERIALS.
+uniform Material instanceMaterials[4];
+#endif
+
 
 void main()
 {
+	float h = (Height + 16) / 32.0f;
+	vec4 greyScale = vec4(h, h, h, 1.0);
+
+#ifdef TEXTURED
+	// The indirect program draws terrain and meshes together, and only the meshes are textured
+	if (TerrainVertex == 0)
+	{
+		greyScale *= texture(theTexture, TexCoord);
+	}
+#endif
+
+#ifdef LIT
 	vec4 ambientColour = vec4(directionalLight.colour, 1.0f) * directionalLight.ambientIntensity;
 
 	float diffuseFactor = max(dot(normalize(Normal), normalize(directionalLight.direction)), 0.0f);
@@ -39,6 +74,13 @@ void main()
 
 	vec4 specularColour = vec4(0, 0, 0, 0);
 
+#ifdef SPECULAR
+	Material activeMaterial = material;
+	if (MaterialIndex >= 0)
+	{
+		activeMaterial = instanceMaterials[MaterialIndex];
+	}
+
 	if(diffuseFactor > 0.0f)
 	{
 		vec3 fragToEye = normalize(eyePosition - FragPos);
@@ -47,15 +89,14 @@ void main()
 		float specularFactor = dot(fragToEye, reflectedVertex);
 		if(specularFactor > 0.0f)
 		{
-			specularFactor = pow(specularFactor, material.shininess);
-			specularColour = vec4(directionalLight.colour * material.specularIntensity * specularFactor, 1.0f);
+			specularFactor = pow(specularFactor, activeMaterial.shininess);
+			specularColour = vec4(directionalLight.colour * activeMaterial.specularIntensity * specularFactor, 1.0f);
 		}
 	}
+#endif
 
-	float h = (Height + 16) / 32.0f;
-	vec4 greyScale = vec4(h, h, h, 1.0);
-
-	//colour = greyScale * texture(theTexture, TexCoord) * (ambientColour + diffuseColour + specularColour);
-	//colour = vCol * greyScale * (ambientColour + diffuseColour + specularColour);
 	colour = greyScale * (ambientColour + diffuseColour + specularColour);
+#else
+	colour = greyScale;
+#endif
 }
\ No newline at end of file
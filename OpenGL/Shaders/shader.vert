@@ -1,30 +1,182 @@
 #version 330
 
+// Compiled in permutations (see ShaderCache). TERRAIN builds terrain vertices from their
+// heights and grid position; without it the terrain code and uniforms are left out.
+
+// Only needed by the indirect path, which isn't used when the extension is missing
+#extension GL_ARB_shader_draw_parameters : enable
+
 layout (location = 0) in vec3 pos;
 layout (location = 1) in vec2 tex;
 layout (location = 2) in vec3 norm;
+layout (location = 3) in vec2 terrainHeights;
+
+// Per-instance attributes, only read when instanced is set.
+// The model matrix takes locations 4 to 7.
+layout (location = 4) in mat4 instanceModel;
+layout (location = 8) in uint instanceMaterial;
 
-out vec4 vCol;
 out vec2 TexCoord;
 out vec3 Normal;
 out float Height;
 out vec3 FragPos;
+flat out int MaterialIndex;
+// Set for vertices built from a terrain grid, which are never textured
+flat out int TerrainVertex;
 
 uniform mat4 model;
-uniform mat4 projection;
-uniform mat4 view;
+
+// Worked out once per object on the CPU: projection * view * model,
+// and the inverse transpose of model's upper 3x3
+uniform mat4 mvp;
+uniform mat3 normalMatrix;
+
+// Shared by every program, written once per frame. Must match FrameUniforms.
+layout (std140) uniform FrameData
+{
+	mat4 projection;
+	mat4 view;
+	vec3 eyePosition;
+	// Build MVP and the normal matrix from modelMatrix for every vertex instead, for comparing the cost
+	bool perVertexMatrices;
+};
+
+// Set while drawing with glDrawElementsInstanced, so model comes from the instance buffer
+uniform bool instanced;
+
+// Set while drawing with glMultiDrawElementsIndirect. Per-draw values then come from
+// drawData, 6 texels per draw starting at drawDataOffset + gl_DrawID:
+// model matrix columns, terrainGrid, (lodLevel, morph start, morph end, material index).
+uniform bool indirect;
+uniform samplerBuffer drawData;
+uniform int drawDataOffset;
+
+// Inverse transpose of m's upper 3x3, scaled by its determinant. The scale doesn't matter
+// since the fragment shader normalizes the normal, so no inverse is needed.
+mat3 getNormalMatrix(mat4 m)
+{
+	vec3 a = m[0].xyz;
+	vec3 b = m[1].xyz;
+	vec3 c = m[2].xyz;
+	return mat3(cross(b, c), cross(c, a), cross(a, b));
+}
+
+#ifdef TERRAIN
+// Terrain vertices only store terrainHeights: the 16-bit height sample and the sample at
+// the next coarser level. Grid x and z come from gl_VertexID and terrainGrid
+// (first row, first column, row quads, column quads); column quads is 0 for non-terrain meshes.
+uniform ivec4 terrainGrid;
+uniform int terrainLevelCount;
+
+// Chunks drawn out of a shared buffer with glDrawElementsBaseVertex see it added to gl_VertexID
+uniform int baseVertex;
+
+// Unpacks (grid row, height sample, grid column) into world space
+uniform vec3 positionScale;
+uniform vec3 positionOffset;
+
+// Terrain level of detail. Vertices of lodLevel morph towards the next coarser level.
+uniform float lodLevel;
+uniform vec2 morphRange;
+
+// Coarsest level a grid line belongs to. Must match TerrainChunkBuilder::getGridLevel.
+int getGridLevel(int coord, int numQuads)
+{
+	if (coord == 0 || coord == numQuads)
+	{
+		return terrainLevelCount - 1;
+	}
+
+	int level = 0;
+	while (level + 1 < terrainLevelCount && (coord & (1 << level)) == 0)
+	{
+		level++;
+	}
+
+	return level;
+}
+#endif
 
 void main()
 {
-	gl_Position = projection * model * view * vec4(pos, 1.0);
-	
-	vCol = vec4(clamp(pos, 0.0f, 1.0f), 1.0f);
+	vec3 position = pos;
+	mat4 modelMatrix = model;
+	MaterialIndex = -1;
+	TerrainVertex = 0;
+
+#ifdef TERRAIN
+	ivec4 grid = terrainGrid;
+	int vertexBase = baseVertex;
+	float drawLodLevel = lodLevel;
+	vec2 drawMorphRange = morphRange;
+#endif
+
+	if (instanced)
+	{
+		modelMatrix = instanceModel;
+		MaterialIndex = int(instanceMaterial);
+	}
+
+#ifdef GL_ARB_shader_draw_parameters
+	if (indirect)
+	{
+		int texel = (drawDataOffset + gl_DrawIDARB) * 6;
+		modelMatrix = mat4(texelFetch(drawData, texel), texelFetch(drawData, texel + 1),
+			texelFetch(drawData, texel + 2), texelFetch(drawData, texel + 3));
+
+		vec4 lod = texelFetch(drawData, texel + 5);
+		MaterialIndex = int(lod.w);
+
+#ifdef TERRAIN
+		grid = ivec4(texelFetch(drawData, texel + 4));
+		drawLodLevel = lod.x;
+		drawMorphRange = lod.yz;
+		vertexBase = gl_BaseVertexARB;
+#endif
+	}
+#endif
+
+#ifdef TERRAIN
+	// Meshes drawn with the terrain through one indirect submission have no grid
+	if (grid.w > 0)
+	{
+		TerrainVertex = 1;
+
+		int vertexIndex = gl_VertexID - vertexBase;
+		int row = vertexIndex / (grid.w + 1);
+		int col = vertexIndex % (grid.w + 1);
+
+		position = vec3(grid.x + row, terrainHeights.x, grid.y + col) * positionScale + positionOffset;
+
+		int level = min(getGridLevel(row, grid.z), getGridLevel(col, grid.w));
+		if (float(level) == drawLodLevel)
+		{
+			float morphFactor = clamp((distance(eyePosition, position) - drawMorphRange.x) / (drawMorphRange.y - drawMorphRange.x), 0.0, 1.0);
+			position.y = mix(position.y, terrainHeights.y * positionScale.y + positionOffset.y, morphFactor);
+		}
+	}
+#endif
+
+	// Instanced and indirect draws get a different model per draw, so only they build the matrices here
+	if (perVertexMatrices)
+	{
+		gl_Position = projection * view * modelMatrix * vec4(position, 1.0);
+		Normal = mat3(transpose(inverse(modelMatrix))) * norm;
+	}
+	else if (instanced || indirect)
+	{
+		gl_Position = projection * view * modelMatrix * vec4(position, 1.0);
+		Normal = getNormalMatrix(modelMatrix) * norm;
+	}
+	else
+	{
+		gl_Position = mvp * vec4(position, 1.0);
+		Normal = normalMatrix * norm;
+	}
 	
 	TexCoord = tex;
 	
-	Normal = mat3(transpose(inverse(model))) * norm;	
-	
-	Height = pos.y;
+	Height = position.y;
 
-    	FragPos = (model * vec4(pos, 1.0)).xyz; 
+    	FragPos = (modelMatrix * vec4(position, 1.0)).xyz; 
 }
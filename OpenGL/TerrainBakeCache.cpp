@@ -0,0 +1,254 @@
+#include <string.h>
+
+#include "TerrainBakeCache.h"
+#include "Hash.h"
+
+static_assert(sizeof(TerrainBakeHeader) == 64, "TerrainBakeHeader must match the file layout");
+static_assert(sizeof(TerrainBakeChunkHeader) == 48, "TerrainBakeChunkHeader must match the file layout");
+
+TerrainBakeCache::TerrainBakeCache()
+{
+	fileLocation = "";
+	key = 0;
+	memset(&header, 0, sizeof(header));
+	output = nullptr;
+	writeFailed = false;
+}
+
+TerrainBakeCache::TerrainBakeCache(const char* fileLoc, uint64_t bakeKey)
+{
+	fileLocation = fileLoc;
+	key = bakeKey;
+	memset(&header, 0, sizeof(header));
+	output = nullptr;
+	writeFailed = false;
+}
+
+uint64_t TerrainBakeCache::computeKey(const char* sourceLoc, float yScale, float yShift, unsigned int chunkSize)
+{
+	MappedFile source;
+	if (!source.open(sourceLoc))
+	{
+		return 0;
+	}
+
+	// Anything that changes the generated chunks has to be part of the key
+	uint64_t hash = FNV_OFFSET_BASIS;
+	hash = hashBytes(hash, source.getData(), source.getSize());
+	hash = hashBytes(hash, &yScale, sizeof(yScale));
+	hash = hashBytes(hash, &yShift, sizeof(yShift));
+	hash = hashBytes(hash, &chunkSize, sizeof(chunkSize));
+	hash = hashBytes(hash, &TERRAIN_BAKE_VERSION, sizeof(TERRAIN_BAKE_VERSION));
+	return hash;
+}
+
+uint64_t TerrainBakeCache::getChunkSize(const TerrainBakeChunkHeader& chunkHeader, unsigned int numLevels)
+{
+	uint64_t size = sizeof(TerrainBakeChunkHeader) + (uint64_t)numLevels * (sizeof(TerrainLodLevel) + sizeof(float)) +
+		(uint64_t)chunkHeader.vertexCount * sizeof(TerrainVertex) + (uint64_t)chunkHeader.indexCount * sizeof(GLuint);
+
+	// Keep every record 8-byte aligned so its vertices can be read in place
+	return (size + 7) & ~(uint64_t)7;
+}
+
+bool TerrainBakeCache::open()
+{
+	close();
+
+	if (!file.open(fileLocation.c_str()))
+	{
+		return false;
+	}
+
+	if (file.getSize() < sizeof(TerrainBakeHeader))
+	{
+		close();
+		return false;
+	}
+
+	memcpy(&header, file.getData(), sizeof(header));
+
+	if (memcmp(header.magic, TERRAIN_BAKE_MAGIC, 4) != 0 || header.version != TERRAIN_BAKE_VERSION || header.key != key)
+	{
+		close();
+		return false;
+	}
+
+	// Walk the records once up front so a truncated file is caught before anything is uploaded
+	size_t offset = sizeof(TerrainBakeHeader);
+	chunkOffsets.reserve(header.chunkCount);
+
+	for (unsigned int i = 0; i < header.chunkCount; i++)
+	{
+		// Compared against what is left of the file, so neither side can overflow
+		size_t remaining = file.getSize() - offset;
+		if (remaining < sizeof(TerrainBakeChunkHeader))
+		{
+			close();
+			return false;
+		}
+
+		const TerrainBakeChunkHeader* chunkHeader = (const TerrainBakeChunkHeader*)(file.getData() + offset);
+		uint64_t chunkSize = getChunkSize(*chunkHeader, header.numLevels);
+
+		if (chunkSize > remaining)
+		{
+			close();
+			return false;
+		}
+
+		chunkOffsets.push_back(offset);
+		offset += (size_t)chunkSize;
+	}
+
+	return true;
+}
+
+const TerrainBakeHeader& TerrainBakeCache::getHeader()
+{
+	return header;
+}
+
+bool TerrainBakeCache::readChunk(unsigned int index, TerrainBakedChunk& chunk)
+{
+	if (index >= chunkOffsets.size())
+	{
+		return false;
+	}
+
+	const unsigned char* record = file.getData() + chunkOffsets[index];
+
+	chunk.header = (const TerrainBakeChunkHeader*)record;
+	record += sizeof(TerrainBakeChunkHeader);
+	chunk.levels = (const TerrainLodLevel*)record;
+	record += header.numLevels * sizeof(TerrainLodLevel);
+	chunk.levelErrors = (const float*)record;
+	record += header.numLevels * sizeof(float);
+	chunk.vertices = (const TerrainVertex*)record;
+	record += chunk.header->vertexCount * sizeof(TerrainVertex);
+	chunk.indices = (const GLuint*)record;
+
+	return true;
+}
+
+void TerrainBakeCache::close()
+{
+	file.close();
+	chunkOffsets.clear();
+}
+
+bool TerrainBakeCache::beginWrite(unsigned int chunkRows, unsigned int chunkCols, unsigned int chunkQuads,
+	unsigned int numLevels, const TerrainQuantization& quantization)
+{
+	close();
+
+	// Written next to the real file first, so a crash never leaves half a bake behind
+	output = fopen((fileLocation + ".tmp").c_str(), "wb");
+	if (!output)
+	{
+		printf("Failed to create terrain bake: %s\n", fileLocation.c_str());
+		return false;
+	}
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, TERRAIN_BAKE_MAGIC, 4);
+	header.version = TERRAIN_BAKE_VERSION;
+	header.key = key;
+	header.chunkRows = chunkRows;
+	header.chunkCols = chunkCols;
+	header.chunkQuads = chunkQuads;
+	header.numLevels = numLevels;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		header.quantizationScale[axis] = quantization.scale[axis];
+		header.quantizationOffset[axis] = quantization.offset[axis];
+	}
+
+	// The chunk count is filled in by endWrite
+	writeFailed = fwrite(&header, sizeof(header), 1, output) != 1;
+	return !writeFailed;
+}
+
+bool TerrainBakeCache::writeChunk(const TerrainChunkGeometry& geometry)
+{
+	if (!output || writeFailed)
+	{
+		return false;
+	}
+
+	TerrainBakeChunkHeader chunkHeader;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		chunkHeader.minBounds[axis] = geometry.minBounds[axis];
+		chunkHeader.maxBounds[axis] = geometry.maxBounds[axis];
+	}
+	chunkHeader.grid = geometry.grid;
+	chunkHeader.vertexCount = geometry.vertices.size();
+	chunkHeader.indexCount = geometry.indices.size();
+
+	size_t written = sizeof(TerrainBakeChunkHeader) + geometry.levels.size() * sizeof(TerrainLodLevel) +
+		geometry.levelErrors.size() * sizeof(float) + geometry.vertices.size() * sizeof(TerrainVertex) +
+		geometry.indices.size() * sizeof(GLuint);
+	size_t paddingSize = (size_t)(getChunkSize(chunkHeader, header.numLevels) - written);
+	const uint64_t padding = 0;
+
+	writeFailed = geometry.levels.size() != header.numLevels ||
+		fwrite(&chunkHeader, sizeof(chunkHeader), 1, output) != 1 ||
+		fwrite(&geometry.levels[0], sizeof(TerrainLodLevel), geometry.levels.size(), output) != geometry.levels.size() ||
+		fwrite(&geometry.levelErrors[0], sizeof(float), geometry.levelErrors.size(), output) != geometry.levelErrors.size() ||
+		fwrite(&geometry.vertices[0], sizeof(TerrainVertex), geometry.vertices.size(), output) != geometry.vertices.size() ||
+		fwrite(&geometry.indices[0], sizeof(GLuint), geometry.indices.size(), output) != geometry.indices.size() ||
+		fwrite(&padding, 1, paddingSize, output) != paddingSize;
+
+	header.chunkCount++;
+	return !writeFailed;
+}
+
+bool TerrainBakeCache::endWrite()
+{
+	if (!output)
+	{
+		return false;
+	}
+
+	// Now that every chunk is in, the header can be finished
+	if (!writeFailed)
+	{
+		writeFailed = fseek(output, 0, SEEK_SET) != 0 || fwrite(&header, sizeof(header), 1, output) != 1;
+	}
+
+	writeFailed = fclose(output) != 0 || writeFailed;
+	output = nullptr;
+
+	std::string tempLocation = fileLocation + ".tmp";
+
+	if (writeFailed)
+	{
+		printf("Failed to write terrain bake: %s\n", fileLocation.c_str());
+		remove(tempLocation.c_str());
+		return false;
+	}
+
+	// rename won't replace an existing file on Windows
+	remove(fileLocation.c_str());
+	if (rename(tempLocation.c_str(), fileLocation.c_str()) != 0)
+	{
+		printf("Failed to write terrain bake: %s\n", fileLocation.c_str());
+		remove(tempLocation.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+TerrainBakeCache::~TerrainBakeCache()
+{
+	if (output)
+	{
+		fclose(output);
+		output = nullptr;
+		remove((fileLocation + ".tmp").c_str());
+	}
+
+	close();
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+
+#include "MappedFile.h"
+#include "TerrainChunkBuilder.h"
+
+/*
+	Terrain bake file (.terrainbake), native endian:
+
+	TerrainBakeHeader
+	chunkCount records, each 8-byte aligned:
+		TerrainBakeChunkHeader
+		TerrainLodLevel levels[numLevels]
+		float levelErrors[numLevels]
+		TerrainVertex vertices[vertexCount]
+		GLuint indices[indexCount]
+*/
+struct TerrainBakeHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint64_t key;
+	uint32_t chunkRows;
+	uint32_t chunkCols;
+	uint32_t chunkQuads;
+	uint32_t numLevels;
+	float quantizationScale[3];
+	float quantizationOffset[3];
+	uint32_t chunkCount;
+	uint32_t reserved;
+};
+
+struct TerrainBakeChunkHeader
+{
+	float minBounds[3];
+	float maxBounds[3];
+	TerrainChunkGrid grid;
+	uint32_t vertexCount;
+	uint32_t indexCount;
+};
+
+// One chunk of a bake, pointing straight into the mapped file
+struct TerrainBakedChunk
+{
+	const TerrainBakeChunkHeader* header;
+	const TerrainLodLevel* levels;
+	const float* levelErrors;
+	const TerrainVertex* vertices;
+	const GLuint* indices;
+};
+
+const char TERRAIN_BAKE_MAGIC[4] = { 'T', 'B', 'K', '1' };
+
+// Bumped whenever the chunk layout or how chunks are generated changes, so stale bakes are rebuilt
+const uint32_t TERRAIN_BAKE_VERSION = 1;
+
+// Saves the built terrain chunks so later runs can skip decoding and generation.
+// Bakes are keyed by a hash of the source heightmap and the generation parameters.
+class TerrainBakeCache
+{
+public:
+	TerrainBakeCache();
+	TerrainBakeCache(const char* fileLoc, uint64_t bakeKey);
+
+	static uint64_t computeKey(const char* sourceLoc, float yScale, float yShift, unsigned int chunkSize);
+
+	// Reading. Fails if the file is missing, damaged or was baked with a different key.
+	bool open();
+	const TerrainBakeHeader& getHeader();
+	bool readChunk(unsigned int index, TerrainBakedChunk& chunk);
+	void close();
+
+	// Writing. Chunks are written as they are built, then moved into place on endWrite.
+	bool beginWrite(unsigned int chunkRows, unsigned int chunkCols, unsigned int chunkQuads,
+		unsigned int numLevels, const TerrainQuantization& quantization);
+	bool writeChunk(const TerrainChunkGeometry& geometry);
+	bool endWrite();
+
+	~TerrainBakeCache();
+
+private:
+	std::string fileLocation;
+	uint64_t key;
+
+	MappedFile file;
+	TerrainBakeHeader header;
+	std::vector<size_t> chunkOffsets;
+
+	FILE* output;
+	bool writeFailed;
+
+	// 64-bit so the counts read from a damaged file can't wrap the size around
+	static uint64_t getChunkSize(const TerrainBakeChunkHeader& chunkHeader, unsigned int numLevels);
+};
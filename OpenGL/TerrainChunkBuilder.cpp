@@ -0,0 +1,175 @@
+#include <cmath>
+#include <algorithm>
+
+#include "TerrainChunkBuilder.h"
+
+TerrainChunkBuilder::TerrainChunkBuilder()
+{
+	numLevels = 1;
+	quantization.scale = glm::vec3(1.0f);
+	quantization.offset = glm::vec3(0.0f);
+}
+
+TerrainChunkBuilder::TerrainChunkBuilder(unsigned int numLodLevels, const TerrainQuantization& vertexQuantization)
+{
+	numLevels = numLodLevels > 0 ? numLodLevels : 1;
+	quantization = vertexQuantization;
+}
+
+TerrainQuantization TerrainChunkBuilder::getHeightmapQuantization(int width, int height, float yScale, float yShift)
+{
+	// Samples are read in 8-bit units, so a 16-bit step is 1/257 of one
+	TerrainQuantization heightmapQuantization;
+	heightmapQuantization.scale = glm::vec3(1.0f, yScale / 257.0f, 1.0f);
+	heightmapQuantization.offset = glm::vec3(-height / 2.0f, -yShift, -width / 2.0f);
+	return heightmapQuantization;
+}
+
+void TerrainChunkBuilder::build(const float* positions, const GLuint* normals, size_t rowStride, unsigned int rowQuads, unsigned int colQuads,
+	TerrainChunkGeometry& geometry)
+{
+	unsigned int chunkWidth = colQuads + 1;
+
+	// Height of a vertex given its position inside the chunk
+	auto heightAt = [&](unsigned int i, unsigned int j)
+	{
+		return positions[(i * rowStride + j) * 3 + 1];
+	};
+
+	geometry.vertices.clear();
+	geometry.indices.clear();
+	geometry.levels.clear();
+	geometry.levelErrors.assign(numLevels, 0.0f);
+	geometry.minBounds = glm::vec3(positions[0], positions[1], positions[2]);
+	geometry.maxBounds = geometry.minBounds;
+
+	geometry.grid.firstRow = quantize(positions[0], 0);
+	geometry.grid.firstCol = quantize(positions[2], 2);
+	geometry.grid.rowQuads = rowQuads;
+	geometry.grid.colQuads = colQuads;
+
+	// Copy the chunk's vertices, adding morph data and tracking bounds
+	geometry.vertices.reserve((size_t)chunkWidth * (rowQuads + 1));
+
+	for (unsigned int i = 0; i <= rowQuads; i++)
+	{
+		const float* vertex = &positions[i * rowStride * 3];
+
+		for (unsigned int j = 0; j <= colQuads; j++, vertex += 3)
+		{
+			glm::vec3 position(vertex[0], vertex[1], vertex[2]);
+			geometry.minBounds = glm::min(geometry.minBounds, position);
+			geometry.maxBounds = glm::max(geometry.maxBounds, position);
+
+			// The coarsest level this vertex is part of. That's the level it morphs away at.
+			// shader.vert repeats this calculation, so the two must stay in step.
+			unsigned int level = std::min(getGridLevel(i, rowQuads), getGridLevel(j, colQuads));
+			float morphHeight = position.y;
+
+			if (level + 1 < numLevels)
+			{
+				// Find the quad of the next level that contains this vertex
+				unsigned int stride = 1u << (level + 1);
+				unsigned int i0 = i / stride * stride;
+				unsigned int j0 = j / stride * stride;
+				unsigned int i1 = std::min(i0 + stride, rowQuads);
+				unsigned int j1 = std::min(j0 + stride, colQuads);
+				float u = i1 > i0 ? (float)(i - i0) / (i1 - i0) : 0.0f;
+				float v = j1 > j0 ? (float)(j - j0) / (j1 - j0) : 0.0f;
+
+				// Interpolate on whichever of the quad's two triangles the vertex falls in.
+				// Strips split each quad along the (i1, j0) - (i0, j1) diagonal.
+				if (u + v <= 1.0f)
+				{
+					float h00 = heightAt(i0, j0);
+					morphHeight = h00 + u * (heightAt(i1, j0) - h00) + v * (heightAt(i0, j1) - h00);
+				}
+				else
+				{
+					float h11 = heightAt(i1, j1);
+					morphHeight = h11 + (1.0f - u) * (heightAt(i0, j1) - h11) + (1.0f - v) * (heightAt(i1, j0) - h11);
+				}
+
+				geometry.levelErrors[level] = std::max(geometry.levelErrors[level], std::fabs(position.y - morphHeight));
+			}
+
+			// Only heights are stored; the shader derives x, z and the level from the vertex's index
+			TerrainVertex packed;
+			packed.height = quantize(position.y, 1);
+			packed.morphHeight = quantize(morphHeight, 1);
+			packed.normal = normals[i * rowStride + j];
+			geometry.vertices.push_back(packed);
+		}
+	}
+
+	// Every level gets its own run of strips in the same index buffer
+	std::vector<unsigned int> rowGrid, colGrid;
+
+	for (unsigned int level = 0; level < numLevels; level++)
+	{
+		getLevelGrid(level, rowQuads, rowGrid);
+		getLevelGrid(level, colQuads, colGrid);
+
+		TerrainLodLevel lod;
+		lod.firstIndex = geometry.indices.size();
+		lod.numStrips = rowGrid.size() - 1;
+		lod.numVertsPerStrip = colGrid.size() * 2;
+
+		for (size_t r = 0; r + 1 < rowGrid.size(); r++)
+		{
+			for (size_t c = 0; c < colGrid.size(); c++)
+			{
+				geometry.indices.push_back(colGrid[c] + chunkWidth * rowGrid[r]);
+				geometry.indices.push_back(colGrid[c] + chunkWidth * rowGrid[r + 1]);
+			}
+
+			geometry.indices.push_back(HEIGHTMAP_RESTART_INDEX);
+		}
+
+		geometry.levels.push_back(lod);
+	}
+}
+
+unsigned int TerrainChunkBuilder::getLevelCount()
+{
+	return numLevels;
+}
+
+GLushort TerrainChunkBuilder::quantize(float value, int axis)
+{
+	float step = std::round((value - quantization.offset[axis]) / quantization.scale[axis]);
+	return (GLushort)std::min(std::max(step, 0.0f), 65535.0f);
+}
+
+unsigned int TerrainChunkBuilder::getGridLevel(unsigned int coord, unsigned int numQuads)
+{
+	// Chunk edges are kept at every level so neighbouring chunks always line up
+	if (coord == 0 || coord == numQuads)
+	{
+		return numLevels - 1;
+	}
+
+	unsigned int level = 0;
+	while (level + 1 < numLevels && (coord & (1u << level)) == 0)
+	{
+		level++;
+	}
+
+	return level;
+}
+
+void TerrainChunkBuilder::getLevelGrid(unsigned int level, unsigned int numQuads, std::vector<unsigned int>& grid)
+{
+	unsigned int stride = 1u << level;
+
+	grid.clear();
+	for (unsigned int coord = 0; coord < numQuads; coord += stride)
+	{
+		grid.push_back(coord);
+	}
+	grid.push_back(numQuads);
+}
+
+TerrainChunkBuilder::~TerrainChunkBuilder()
+{
+}
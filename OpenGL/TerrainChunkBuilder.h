@@ -0,0 +1,88 @@
+#pragma once
+
+#include <vector>
+
+#include <glm\glm.hpp>
+
+#include "Mesh.h"
+
+// Terrain positions are unpacked with (grid row, height sample, grid column) * scale + offset
+struct TerrainQuantization
+{
+	glm::vec3 scale;
+	glm::vec3 offset;
+};
+
+// Where a chunk's vertices sit in the heightmap grid. Vertex n of the chunk is at
+// row firstRow + n / (colQuads + 1), column firstCol + n % (colQuads + 1).
+struct TerrainChunkGrid
+{
+	GLint firstRow;
+	GLint firstCol;
+	GLint rowQuads;
+	GLint colQuads;
+};
+
+// Shader locations the terrain renderers write to
+struct TerrainUniforms
+{
+	GLuint lodLevel;
+	GLuint morphRange;
+	GLuint positionScale;
+	GLuint positionOffset;
+	GLuint grid;
+	GLuint levelCount;
+	GLuint baseVertex;
+};
+
+// One level of detail of a chunk, stored as a range of the chunk's index buffer
+struct TerrainLodLevel
+{
+	GLsizei firstIndex;
+	unsigned int numStrips;
+	unsigned int numVertsPerStrip;
+};
+
+// CPU-side mesh data for one terrain chunk, ready to be uploaded with createMeshFromHeightmap
+struct TerrainChunkGeometry
+{
+	std::vector<TerrainVertex> vertices;
+	std::vector<unsigned int> indices;
+	std::vector<TerrainLodLevel> levels;
+	TerrainChunkGrid grid;
+
+	// Largest height error introduced by dropping the vertices of each level
+	std::vector<float> levelErrors;
+
+	glm::vec3 minBounds;
+	glm::vec3 maxBounds;
+};
+
+// Turns a grid of heightmap positions into chunk geometry with every level of detail.
+// Doesn't touch OpenGL, so it can run on any thread.
+class TerrainChunkBuilder
+{
+public:
+	TerrainChunkBuilder();
+	TerrainChunkBuilder(unsigned int numLodLevels, const TerrainQuantization& vertexQuantization);
+
+	// Grid steps map to one unit and heights to the 16-bit samples they came from
+	static TerrainQuantization getHeightmapQuantization(int width, int height, float yScale, float yShift);
+
+	// positions are xyz and normals packed by HeightmapGenerator::generateNormals, both rowStride vertices per row
+	void build(const float* positions, const GLuint* normals, size_t rowStride, unsigned int rowQuads, unsigned int colQuads,
+		TerrainChunkGeometry& geometry);
+
+	unsigned int getLevelCount();
+
+	~TerrainChunkBuilder();
+
+private:
+	unsigned int numLevels;
+	TerrainQuantization quantization;
+
+	GLushort quantize(float value, int axis);
+
+	unsigned int getGridLevel(unsigned int coord, unsigned int numQuads);
+	void getLevelGrid(unsigned int level, unsigned int numQuads, std::vector<unsigned int>& grid);
+};
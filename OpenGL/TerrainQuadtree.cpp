@@ -0,0 +1,499 @@
+#include <stdio.h>
+#include <cmath>
+#include <algorithm>
+
+#include <glm\gtc\type_ptr.hpp>
+
+#include "TerrainQuadtree.h"
+
+// How far through a level's distance band vertices start morphing to the next level
+const GLfloat TERRAIN_MORPH_START = 0.7f;
+
+// Arena block size. A 64 quad chunk with all its levels is about 4k vertices and 10k indices.
+const size_t TERRAIN_BLOCK_VERTICES = 1 << 20;
+const size_t TERRAIN_BLOCK_INDICES = 1 << 22;
+
+TerrainQuadtree::TerrainQuadtree()
+{
+	chunkRows = 0;
+	chunkCols = 0;
+	chunkQuads = 0;
+	visibleChunks = 0;
+	culledChunks = 0;
+	drawnVertices = 0;
+	vertexCount = 0;
+
+	lodEnabled = true;
+	numLevels = 1;
+	lodScale = 0.0f;
+	quantization.scale = glm::vec3(1.0f);
+	quantization.offset = glm::vec3(0.0f);
+
+	eye = glm::vec3(0.0f);
+	mode = TERRAIN_DRAW_PRIMITIVE_RESTART;
+	uniforms = TerrainUniforms();
+	drawList = nullptr;
+	drawModel = glm::mat4(1.0f);
+	geometry.init(GEOMETRY_FORMAT_TERRAIN, TERRAIN_BLOCK_VERTICES, TERRAIN_BLOCK_INDICES);
+}
+
+void TerrainQuadtree::build(const std::vector<float>& vertices, const std::vector<GLuint>& normals, int width, int height,
+	unsigned int chunkSize, const TerrainQuantization& vertexQuantization, TerrainBakeCache* bake)
+{
+	clear();
+	quantization = vertexQuantization;
+
+	if (width < 2 || height < 2 || chunkSize == 0)
+	{
+		return;
+	}
+
+	// Chunks share their border vertices, so a chunk spans chunkSize quads
+	chunkQuads = chunkSize;
+	chunkRows = (height - 2) / chunkSize + 1;
+	chunkCols = (width - 2) / chunkSize + 1;
+
+	numLevels = getLevelCount(chunkSize);
+	levelErrors.assign(numLevels, 0.0f);
+
+	if (bake && !bake->beginWrite(chunkRows, chunkCols, chunkQuads, numLevels, quantization))
+	{
+		bake = nullptr;
+	}
+
+	TerrainChunkBuilder builder(numLevels, quantization);
+	TerrainChunkGeometry geometry;
+
+	for (unsigned int row = 0; row < chunkRows; row++)
+	{
+		for (unsigned int col = 0; col < chunkCols; col++)
+		{
+			unsigned int firstRow = row * chunkSize;
+			unsigned int firstCol = col * chunkSize;
+			unsigned int lastRow = std::min(firstRow + chunkSize, (unsigned int)height - 1);
+			unsigned int lastCol = std::min(firstCol + chunkSize, (unsigned int)width - 1);
+
+			builder.build(&vertices[((size_t)firstRow * width + firstCol) * 3], &normals[(size_t)firstRow * width + firstCol], width,
+				lastRow - firstRow, lastCol - firstCol, geometry);
+
+			addChunk(geometry.minBounds, geometry.maxBounds, geometry.grid, &geometry.levels[0], &geometry.levelErrors[0],
+				&geometry.vertices[0], geometry.vertices.size(), &geometry.indices[0], geometry.indices.size());
+
+			if (bake)
+			{
+				bake->writeChunk(geometry);
+			}
+		}
+	}
+
+	if (bake)
+	{
+		bake->endWrite();
+	}
+
+	finishBuild();
+}
+
+bool TerrainQuadtree::build(TerrainBakeCache& bake)
+{
+	clear();
+
+	// The header comes from disk, so it has to describe the grid and levels build would have made
+	const TerrainBakeHeader& header = bake.getHeader();
+	if (header.chunkCount == 0 || header.chunkCount != (uint64_t)header.chunkRows * header.chunkCols ||
+		header.chunkQuads == 0 || header.numLevels != getLevelCount(header.chunkQuads))
+	{
+		printf("Terrain bake has an invalid header, rebuilding\n");
+		return false;
+	}
+
+	chunkQuads = header.chunkQuads;
+	chunkRows = header.chunkRows;
+	chunkCols = header.chunkCols;
+	numLevels = header.numLevels;
+	levelErrors.assign(numLevels, 0.0f);
+	quantization.scale = glm::vec3(header.quantizationScale[0], header.quantizationScale[1], header.quantizationScale[2]);
+	quantization.offset = glm::vec3(header.quantizationOffset[0], header.quantizationOffset[1], header.quantizationOffset[2]);
+
+	// Buffers are uploaded straight from the mapped file
+	TerrainBakedChunk baked;
+	for (unsigned int i = 0; i < header.chunkCount; i++)
+	{
+		if (!bake.readChunk(i, baked) || !isValidBakedChunk(baked))
+		{
+			printf("Terrain bake chunk %u is invalid, rebuilding\n", i);
+			clear();
+			return false;
+		}
+
+		const TerrainBakeChunkHeader& chunkHeader = *baked.header;
+		addChunk(glm::vec3(chunkHeader.minBounds[0], chunkHeader.minBounds[1], chunkHeader.minBounds[2]),
+			glm::vec3(chunkHeader.maxBounds[0], chunkHeader.maxBounds[1], chunkHeader.maxBounds[2]),
+			chunkHeader.grid, baked.levels, baked.levelErrors,
+			baked.vertices, chunkHeader.vertexCount, baked.indices, chunkHeader.indexCount);
+	}
+
+	finishBuild();
+	return true;
+}
+
+// Level n halves the grid n times, down to a single quad per chunk
+unsigned int TerrainQuadtree::getLevelCount(unsigned int chunkSize)
+{
+	unsigned int levels = 1;
+	while (levels < 32 && (1u << levels) <= chunkSize)
+	{
+		levels++;
+	}
+	return levels;
+}
+
+// Checks a chunk's level ranges and indices stay inside its own buffers before they are drawn
+bool TerrainQuadtree::isValidBakedChunk(const TerrainBakedChunk& baked)
+{
+	const TerrainBakeChunkHeader& chunkHeader = *baked.header;
+
+	for (unsigned int level = 0; level < numLevels; level++)
+	{
+		// Each strip is followed by a restart index
+		const TerrainLodLevel& lod = baked.levels[level];
+		uint64_t levelIndices = (uint64_t)lod.numStrips * ((uint64_t)lod.numVertsPerStrip + 1);
+		if (lod.firstIndex < 0 || (uint64_t)lod.firstIndex > chunkHeader.indexCount ||
+			levelIndices > chunkHeader.indexCount - (uint64_t)lod.firstIndex)
+		{
+			return false;
+		}
+	}
+
+	for (uint32_t i = 0; i < chunkHeader.indexCount; i++)
+	{
+		if (baked.indices[i] != HEIGHTMAP_RESTART_INDEX && baked.indices[i] >= chunkHeader.vertexCount)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void TerrainQuadtree::addChunk(const glm::vec3& minBounds, const glm::vec3& maxBounds, const TerrainChunkGrid& grid,
+	const TerrainLodLevel* levels, const float* chunkLevelErrors,
+	const TerrainVertex* vertices, size_t numVertices, const GLuint* indices, size_t numIndices)
+{
+	TerrainChunk chunk;
+	chunk.mesh = new Mesh(&geometry);
+	chunk.mesh->createMeshFromHeightmap(vertices, numVertices, indices, numIndices);
+	chunk.minBounds = minBounds;
+	chunk.maxBounds = maxBounds;
+	chunk.levels.assign(levels, levels + numLevels);
+	chunk.grid = grid;
+	chunks.push_back(chunk);
+	vertexCount += numVertices;
+
+	for (unsigned int level = 0; level < numLevels; level++)
+	{
+		levelErrors[level] = std::max(levelErrors[level], chunkLevelErrors[level]);
+	}
+}
+
+void TerrainQuadtree::finishBuild()
+{
+	buildNode(0, chunkRows, 0, chunkCols);
+	computeLevelRanges();
+
+	printf("Terrain split into %u chunks (%u x %u), %zu quadtree nodes, %u LOD levels\n",
+		(unsigned int)chunks.size(), chunkRows, chunkCols, nodes.size(), numLevels);
+	reportVertexMemory();
+}
+
+void TerrainQuadtree::reportVertexMemory()
+{
+	// Earlier layouts plus a normal: five floats (x, y, z, morph height, morph level) and a float normal,
+	// then the same as six uint16s and a packed normal
+	const double floatVertexSize = 8 * sizeof(GLfloat);
+	const double packedVertexSize = 6 * sizeof(GLushort) + sizeof(GLuint);
+	const double megabyte = 1024.0 * 1024.0;
+
+	printf("Terrain vertex memory for %zu vertices:\n", vertexCount);
+	printf("  xyz + morph + normal as floats:  %7.2f MB (%2.0f bytes/vertex)\n", vertexCount * floatVertexSize / megabyte, floatVertexSize);
+	printf("  xyz + morph as uint16 + normal:  %7.2f MB (%2.0f bytes/vertex)\n", vertexCount * packedVertexSize / megabyte, packedVertexSize);
+	printf("  heights + normal:                %7.2f MB (%2u bytes/vertex, %.1fx smaller than uint16 xyz)\n",
+		vertexCount * sizeof(TerrainVertex) / megabyte, (unsigned int)sizeof(TerrainVertex), packedVertexSize / sizeof(TerrainVertex));
+}
+
+void TerrainQuadtree::setLodParameters(GLfloat viewportHeight, GLfloat fovY, GLfloat pixelTolerance)
+{
+	// A height error of e at distance d covers e * lodScale / d pixels on screen
+	lodScale = viewportHeight / (2.0f * tanf(fovY / 2.0f)) / pixelTolerance;
+	computeLevelRanges();
+}
+
+void TerrainQuadtree::computeLevelRanges()
+{
+	levelRanges.assign(numLevels, 0.0f);
+
+	GLfloat accumulatedError = 0.0f;
+	for (unsigned int level = 1; level < numLevels; level++)
+	{
+		accumulatedError += levelErrors[level - 1];
+
+		// Level n is allowed once its error drops under the pixel tolerance. Bands are kept
+		// wider than a chunk so neighbouring chunks never differ by more than one level.
+		levelRanges[level] = std::max(accumulatedError * lodScale, levelRanges[level - 1] + chunkQuads * 3.0f);
+	}
+}
+
+void TerrainQuadtree::setLodEnabled(bool enabled)
+{
+	lodEnabled = enabled;
+}
+
+bool TerrainQuadtree::getLodEnabled()
+{
+	return lodEnabled;
+}
+
+
+int TerrainQuadtree::buildNode(unsigned int rowStart, unsigned int rowEnd, unsigned int colStart, unsigned int colEnd)
+{
+	int nodeIndex = nodes.size();
+	nodes.push_back(TerrainNode());
+
+	TerrainNode node;
+	node.chunk = -1;
+	node.chunkCount = 0;
+	for (int c = 0; c < 4; c++)
+	{
+		node.children[c] = -1;
+	}
+
+	if (rowEnd - rowStart == 1 && colEnd - colStart == 1)
+	{
+		// Leaf
+		node.chunk = rowStart * chunkCols + colStart;
+		node.chunkCount = 1;
+		node.minBounds = chunks[node.chunk].minBounds;
+		node.maxBounds = chunks[node.chunk].maxBounds;
+	}
+	else
+	{
+		// Split into up to four quadrants, skipping empty ones on odd-sized grids
+		unsigned int rowMid = rowStart + (rowEnd - rowStart + 1) / 2;
+		unsigned int colMid = colStart + (colEnd - colStart + 1) / 2;
+		unsigned int rowRanges[2][2] = { { rowStart, rowMid }, { rowMid, rowEnd } };
+		unsigned int colRanges[2][2] = { { colStart, colMid }, { colMid, colEnd } };
+		int childCount = 0;
+
+		for (int r = 0; r < 2; r++)
+		{
+			for (int c = 0; c < 2; c++)
+			{
+				if (rowRanges[r][0] == rowRanges[r][1] || colRanges[c][0] == colRanges[c][1])
+				{
+					continue;
+				}
+
+				int child = buildNode(rowRanges[r][0], rowRanges[r][1], colRanges[c][0], colRanges[c][1]);
+
+				if (childCount == 0)
+				{
+					node.minBounds = nodes[child].minBounds;
+					node.maxBounds = nodes[child].maxBounds;
+				}
+				else
+				{
+					node.minBounds = glm::min(node.minBounds, nodes[child].minBounds);
+					node.maxBounds = glm::max(node.maxBounds, nodes[child].maxBounds);
+				}
+
+				node.chunkCount += nodes[child].chunkCount;
+				node.children[childCount++] = child;
+			}
+		}
+	}
+
+	nodes[nodeIndex] = node;
+	return nodeIndex;
+}
+
+void TerrainQuadtree::beginRender(const glm::mat4& clipMatrix, const glm::vec3& eyePosition, const TerrainUniforms& terrainUniforms)
+{
+	eye = eyePosition;
+	uniforms = terrainUniforms;
+
+	// A level of -1 matches no vertex, so nothing morphs
+	glUniform1f(uniforms.lodLevel, -1.0f);
+	glUniform1i(uniforms.levelCount, numLevels);
+	glUniform3fv(uniforms.positionScale, 1, glm::value_ptr(quantization.scale));
+	glUniform3fv(uniforms.positionOffset, 1, glm::value_ptr(quantization.offset));
+
+	frustum.extractPlanes(clipMatrix);
+}
+
+void TerrainQuadtree::render(const glm::mat4& clipMatrix, const glm::vec3& eyePosition, const glm::mat4& model,
+	IndirectDrawList& indirectDrawList, const TerrainUniforms& terrainUniforms)
+{
+	visibleChunks = 0;
+	culledChunks = 0;
+	drawnVertices = 0;
+
+	if (nodes.empty())
+	{
+		return;
+	}
+
+	beginRender(clipMatrix, eyePosition, terrainUniforms);
+	drawList = &indirectDrawList;
+	drawModel = model;
+
+	renderNode(0);
+
+	drawList = nullptr;
+}
+
+void TerrainQuadtree::render(const glm::mat4& clipMatrix, const glm::vec3& eyePosition, TerrainDrawMode drawMode,
+	const TerrainUniforms& terrainUniforms)
+{
+	visibleChunks = 0;
+	culledChunks = 0;
+	drawnVertices = 0;
+
+	if (nodes.empty())
+	{
+		return;
+	}
+
+	beginRender(clipMatrix, eyePosition, terrainUniforms);
+	mode = drawMode;
+
+	renderNode(0);
+
+	// Leave morphing and grid positions off for whatever is drawn next
+	glUniform1f(uniforms.lodLevel, -1.0f);
+	glUniform4i(uniforms.grid, 0, 0, 0, 0);
+	glUniform1i(uniforms.baseVertex, 0);
+}
+
+void TerrainQuadtree::renderNode(int nodeIndex)
+{
+	const TerrainNode& node = nodes[nodeIndex];
+
+	// Everything under a node outside the frustum is culled in one go
+	if (!frustum.intersectsAABB(node.minBounds, node.maxBounds))
+	{
+		culledChunks += node.chunkCount;
+		return;
+	}
+
+	if (node.chunk >= 0)
+	{
+		renderChunk(chunks[node.chunk]);
+		visibleChunks++;
+		return;
+	}
+
+	for (int c = 0; c < 4 && node.children[c] >= 0; c++)
+	{
+		renderNode(node.children[c]);
+	}
+}
+
+void TerrainQuadtree::renderChunk(TerrainChunk& chunk)
+{
+	unsigned int level = 0;
+	GLfloat morphStart = 0.0f;
+	GLfloat morphEnd = 0.0f;
+
+	if (lodEnabled)
+	{
+		// Pick the coarsest level whose band starts before the nearest point of the chunk
+		glm::vec3 nearest = glm::clamp(eye, chunk.minBounds, chunk.maxBounds);
+		GLfloat distance = glm::distance(eye, nearest);
+
+		while (level + 1 < numLevels && levelRanges[level + 1] <= distance)
+		{
+			level++;
+		}
+
+		// Morphing finishes exactly where the next level takes over.
+		// The coarsest level's morph targets are its own heights, so its band doesn't matter.
+		GLfloat bandStart = levelRanges[level];
+		GLfloat bandEnd = level + 1 < numLevels ? levelRanges[level + 1] : bandStart + 1.0f;
+
+		morphStart = bandStart + (bandEnd - bandStart) * TERRAIN_MORPH_START;
+		morphEnd = bandEnd;
+	}
+
+	const TerrainLodLevel& lod = chunk.levels[level];
+	drawnVertices += lod.numStrips * lod.numVertsPerStrip;
+
+	if (drawList)
+	{
+		// Level -1 turns morphing off, as the lodLevel uniform does
+		IndirectDrawData data;
+		data.model = drawModel;
+		data.grid = glm::vec4(chunk.grid.firstRow, chunk.grid.firstCol, chunk.grid.rowQuads, chunk.grid.colQuads);
+		data.lod = glm::vec4(lodEnabled ? (GLfloat)level : -1.0f, morphStart, morphEnd, -1.0f);
+
+		chunk.mesh->addHeightmapToDrawList(*drawList, lod.firstIndex, lod.numStrips, lod.numVertsPerStrip, data);
+		return;
+	}
+
+	if (lodEnabled)
+	{
+		glUniform1f(uniforms.lodLevel, (GLfloat)level);
+		glUniform2f(uniforms.morphRange, morphStart, morphEnd);
+	}
+
+	glUniform4i(uniforms.grid, chunk.grid.firstRow, chunk.grid.firstCol, chunk.grid.rowQuads, chunk.grid.colQuads);
+	glUniform1i(uniforms.baseVertex, chunk.mesh->getBaseVertex());
+
+	chunk.mesh->renderMeshFromHeightmap(lod.firstIndex, lod.numStrips, lod.numVertsPerStrip, mode);
+}
+
+unsigned int TerrainQuadtree::getChunkCount()
+{
+	return chunks.size();
+}
+
+unsigned int TerrainQuadtree::getVisibleChunkCount()
+{
+	return visibleChunks;
+}
+
+unsigned int TerrainQuadtree::getCulledChunkCount()
+{
+	return culledChunks;
+}
+
+unsigned int TerrainQuadtree::getDrawnVertexCount()
+{
+	return drawnVertices;
+}
+
+void TerrainQuadtree::clear()
+{
+	for (size_t i = 0; i < chunks.size(); i++)
+	{
+		delete chunks[i].mesh;
+	}
+
+	chunks.clear();
+	nodes.clear();
+	geometry.clear();
+	levelErrors.clear();
+	levelRanges.clear();
+	chunkRows = 0;
+	chunkCols = 0;
+	chunkQuads = 0;
+	numLevels = 1;
+	vertexCount = 0;
+	visibleChunks = 0;
+	culledChunks = 0;
+	drawnVertices = 0;
+}
+
+TerrainQuadtree::~TerrainQuadtree()
+{
+	clear();
+}
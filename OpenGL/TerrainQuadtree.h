@@ -0,0 +1,104 @@
+#pragma once
+
+#include <vector>
+
+#include <glm\glm.hpp>
+
+#include "Mesh.h"
+#include "Frustum.h"
+#include "TerrainChunkBuilder.h"
+#include "TerrainBakeCache.h"
+
+// A fixed-size square of the heightmap with its bounds. The mesh lives in the quadtree's arena.
+struct TerrainChunk
+{
+	Mesh* mesh;
+	glm::vec3 minBounds;
+	glm::vec3 maxBounds;
+	std::vector<TerrainLodLevel> levels;
+	TerrainChunkGrid grid;
+};
+
+// Quadtree node covering a rectangle of chunks. Leaves point at a single chunk.
+struct TerrainNode
+{
+	glm::vec3 minBounds;
+	glm::vec3 maxBounds;
+	int children[4];
+	int chunk;
+	unsigned int chunkCount;
+};
+
+// Splits a heightmap into chunks and only draws the ones inside the camera frustum.
+// Chunks further away are drawn with coarser grids (CDLOD-style), chosen by screen-space
+// error, and vertices morph towards the next coarser grid so levels don't pop.
+class TerrainQuadtree
+{
+public:
+	TerrainQuadtree();
+
+	// Builds chunks from heightmap vertices, also writing them to bake when one is given
+	void build(const std::vector<float>& vertices, const std::vector<GLuint>& normals, int width, int height,
+		unsigned int chunkSize, const TerrainQuantization& vertexQuantization, TerrainBakeCache* bake);
+	// Uploads chunks from an opened bake without regenerating anything
+	bool build(TerrainBakeCache& bake);
+	void setLodParameters(GLfloat viewportHeight, GLfloat fovY, GLfloat pixelTolerance);
+	void setLodEnabled(bool enabled);
+	bool getLodEnabled();
+
+	void render(const glm::mat4& clipMatrix, const glm::vec3& eyePosition, TerrainDrawMode drawMode,
+		const TerrainUniforms& terrainUniforms);
+	// Queues the visible chunks in drawList instead of drawing them.
+	// Only the uniforms shared by every chunk are set here.
+	void render(const glm::mat4& clipMatrix, const glm::vec3& eyePosition, const glm::mat4& model,
+		IndirectDrawList& drawList, const TerrainUniforms& terrainUniforms);
+
+	unsigned int getChunkCount();
+	unsigned int getVisibleChunkCount();
+	unsigned int getCulledChunkCount();
+	unsigned int getDrawnVertexCount();
+
+	void clear();
+
+	~TerrainQuadtree();
+
+private:
+	std::vector<TerrainChunk> chunks;
+	std::vector<TerrainNode> nodes;
+	Frustum frustum;
+	TerrainQuantization quantization;
+
+	// Every chunk's vertices and indices, so drawing a chunk doesn't rebind buffers
+	GeometryArena geometry;
+
+	unsigned int chunkRows, chunkCols, chunkQuads;
+	unsigned int visibleChunks, culledChunks, drawnVertices;
+	size_t vertexCount;
+
+	// Level of detail
+	bool lodEnabled;
+	unsigned int numLevels;
+	GLfloat lodScale;
+	std::vector<GLfloat> levelErrors;
+	std::vector<GLfloat> levelRanges;
+
+	// Per-frame state used while walking the tree
+	glm::vec3 eye;
+	TerrainDrawMode mode;
+	TerrainUniforms uniforms;
+	IndirectDrawList* drawList;
+	glm::mat4 drawModel;
+
+	void addChunk(const glm::vec3& minBounds, const glm::vec3& maxBounds, const TerrainChunkGrid& grid,
+		const TerrainLodLevel* levels, const float* chunkLevelErrors,
+		const TerrainVertex* vertices, size_t numVertices, const GLuint* indices, size_t numIndices);
+	void finishBuild();
+	static unsigned int getLevelCount(unsigned int chunkSize);
+	bool isValidBakedChunk(const TerrainBakedChunk& baked);
+	int buildNode(unsigned int rowStart, unsigned int rowEnd, unsigned int colStart, unsigned int colEnd);
+	void renderNode(int nodeIndex);
+	void beginRender(const glm::mat4& clipMatrix, const glm::vec3& eyePosition, const TerrainUniforms& terrainUniforms);
+	void renderChunk(TerrainChunk& chunk);
+	void computeLevelRanges();
+	void reportVertexMemory();
+};
@@ -0,0 +1,437 @@
+#include <stdio.h>
+#include <cmath>
+#include <algorithm>
+
+#include <glm\gtc\type_ptr.hpp>
+
+#include "TerrainStreamer.h"
+
+// Finished tiles the loader may queue before it waits for the render thread to catch up
+const size_t TERRAIN_MAX_COMPLETED_TILES = 8;
+
+static long long makeTileKey(int row, int col)
+{
+	return ((long long)row << 32) | (unsigned int)col;
+}
+
+static int getTileRow(long long key)
+{
+	return (int)(key >> 32);
+}
+
+static int getTileCol(long long key)
+{
+	return (int)(key & 0xFFFFFFFF);
+}
+
+TerrainStreamer::TerrainStreamer()
+{
+	source = nullptr;
+	tileSize = 0;
+	radius = 0;
+	tileRows = 0;
+	tileCols = 0;
+	budget = 0;
+	heightScale = 1.0f;
+	heightShift = 0.0f;
+	quantization.scale = glm::vec3(1.0f);
+	quantization.offset = glm::vec3(0.0f);
+	normalGenerator = HeightmapGenerator(1);
+
+	residentBytes = 0;
+	frame = 0;
+	hits = 0;
+	misses = 0;
+	evictions = 0;
+	budgetWarningShown = false;
+
+	inFlightTile = -1;
+	stopping = false;
+}
+
+void TerrainStreamer::start(HeightmapTileSource* tileSource, unsigned int tileQuads, size_t memoryBudget, unsigned int loadRadius,
+	float yScale, float yShift)
+{
+	stop();
+
+	if (!tileSource || !tileSource->open() || tileQuads == 0)
+	{
+		return;
+	}
+
+	source = tileSource;
+	tileSize = tileQuads;
+	radius = loadRadius;
+	budget = memoryBudget;
+	heightScale = yScale;
+	heightShift = yShift;
+	quantization = TerrainChunkBuilder::getHeightmapQuantization(source->getWidth(), source->getHeight(), yScale, yShift);
+
+	// Tiles share their border samples, like terrain chunks
+	tileRows = (source->getHeight() - 2) / tileSize + 1;
+	tileCols = (source->getWidth() - 2) / tileSize + 1;
+
+	stopping = false;
+	loader = std::thread(&TerrainStreamer::loaderLoop, this);
+
+	printf("Streaming %d x %d heightmap as %u x %u tiles, budget %.1f MB\n",
+		source->getHeight(), source->getWidth(), tileRows, tileCols, budget / (1024.0 * 1024.0));
+}
+
+void TerrainStreamer::update(const glm::vec3& eyePosition, unsigned int maxUploadsPerFrame)
+{
+	if (!source)
+	{
+		return;
+	}
+
+	frame++;
+
+	// Heightmap rows run along x and columns along z, centred on the origin
+	int eyeRow = (int)std::floor((eyePosition.x + source->getHeight() / 2.0f) / tileSize);
+	int eyeCol = (int)std::floor((eyePosition.z + source->getWidth() / 2.0f) / tileSize);
+
+	std::vector<std::pair<int, long long>> missing;
+	std::unordered_set<long long> wanted;
+
+	for (int row = eyeRow - (int)radius; row <= eyeRow + (int)radius; row++)
+	{
+		for (int col = eyeCol - (int)radius; col <= eyeCol + (int)radius; col++)
+		{
+			if (row < 0 || col < 0 || row >= (int)tileRows || col >= (int)tileCols)
+			{
+				continue;
+			}
+
+			long long key = makeTileKey(row, col);
+			wanted.insert(key);
+
+			auto resident = residentTiles.find(key);
+			if (resident != residentTiles.end())
+			{
+				hits++;
+
+				// Most recently used tiles live at the front
+				lru.splice(lru.begin(), lru, resident->second.lruPosition);
+				resident->second.lastWantedFrame = frame;
+				continue;
+			}
+
+			// Don't keep retrying tiles the source can't provide
+			if (failedTiles.count(key) > 0)
+			{
+				continue;
+			}
+
+			if (requestedTiles.insert(key).second)
+			{
+				misses++;
+			}
+
+			// Load the closest tiles first
+			int distance = std::abs(row - eyeRow) + std::abs(col - eyeCol);
+			missing.push_back(std::make_pair(distance, key));
+		}
+	}
+
+	// Forget requests the camera has moved away from
+	for (auto it = requestedTiles.begin(); it != requestedTiles.end();)
+	{
+		if (wanted.count(*it) == 0)
+		{
+			it = requestedTiles.erase(it);
+		}
+		else
+		{
+			++it;
+		}
+	}
+
+	std::sort(missing.begin(), missing.end());
+
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+
+		// The queue is rebuilt every frame so it always reflects where the camera is now
+		requestQueue.clear();
+		for (size_t i = 0; i < missing.size(); i++)
+		{
+			if (missing[i].second != inFlightTile)
+			{
+				requestQueue.push_back(missing[i].second);
+			}
+		}
+
+		// Don't ask for tiles that are already finished and waiting to be uploaded
+		for (size_t i = 0; i < completedQueue.size(); i++)
+		{
+			requestQueue.erase(std::remove(requestQueue.begin(), requestQueue.end(), completedQueue[i]->key), requestQueue.end());
+		}
+	}
+	queueCondition.notify_one();
+
+	uploadCompletedTiles(maxUploadsPerFrame);
+	evictTiles();
+}
+
+void TerrainStreamer::uploadCompletedTiles(unsigned int maxUploads)
+{
+	std::vector<LoadedTerrainTile*> ready;
+
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+
+		while (!completedQueue.empty() && ready.size() < maxUploads)
+		{
+			ready.push_back(completedQueue.front());
+			completedQueue.pop_front();
+		}
+	}
+	queueCondition.notify_one();
+
+	for (size_t i = 0; i < ready.size(); i++)
+	{
+		LoadedTerrainTile* tile = ready[i];
+
+		if (tile->failed)
+		{
+			printf("Failed to load terrain tile %d, %d\n", getTileRow(tile->key), getTileCol(tile->key));
+			failedTiles.insert(tile->key);
+			requestedTiles.erase(tile->key);
+		}
+		// Skip tiles the camera no longer needs
+		else if (requestedTiles.erase(tile->key) > 0)
+		{
+			ResidentTerrainTile resident;
+			resident.mesh = new Mesh();
+			resident.mesh->createMeshFromHeightmap(tile->geometry.vertices, tile->geometry.indices);
+			resident.minBounds = tile->geometry.minBounds;
+			resident.maxBounds = tile->geometry.maxBounds;
+			resident.lod = tile->geometry.levels[0];
+			resident.grid = tile->geometry.grid;
+			resident.bytes = tile->geometry.vertices.size() * sizeof(TerrainVertex) + tile->geometry.indices.size() * sizeof(unsigned int);
+			resident.lastWantedFrame = frame;
+
+			lru.push_front(tile->key);
+			resident.lruPosition = lru.begin();
+
+			residentBytes += resident.bytes;
+			residentTiles[tile->key] = resident;
+		}
+
+		delete tile;
+	}
+}
+
+void TerrainStreamer::evictTiles()
+{
+	while (residentBytes > budget && !lru.empty())
+	{
+		long long key = lru.back();
+		ResidentTerrainTile& tile = residentTiles[key];
+
+		// Everything left is in use this frame, so the budget can't hold the load radius
+		if (tile.lastWantedFrame == frame)
+		{
+			if (!budgetWarningShown)
+			{
+				printf("Terrain streaming budget is smaller than the tiles around the camera\n");
+				budgetWarningShown = true;
+			}
+			return;
+		}
+
+		residentBytes -= tile.bytes;
+		delete tile.mesh;
+		residentTiles.erase(key);
+		lru.pop_back();
+		evictions++;
+	}
+}
+
+void TerrainStreamer::render(const glm::mat4& clipMatrix, TerrainDrawMode drawMode, const TerrainUniforms& terrainUniforms)
+{
+	// Streamed tiles are drawn at full resolution, so nothing morphs
+	glUniform1f(terrainUniforms.lodLevel, -1.0f);
+	glUniform1i(terrainUniforms.levelCount, 1);
+	glUniform1i(terrainUniforms.baseVertex, 0);
+	glUniform3fv(terrainUniforms.positionScale, 1, glm::value_ptr(quantization.scale));
+	glUniform3fv(terrainUniforms.positionOffset, 1, glm::value_ptr(quantization.offset));
+
+	frustum.extractPlanes(clipMatrix);
+
+	for (auto it = residentTiles.begin(); it != residentTiles.end(); ++it)
+	{
+		ResidentTerrainTile& tile = it->second;
+
+		if (frustum.intersectsAABB(tile.minBounds, tile.maxBounds))
+		{
+			glUniform4i(terrainUniforms.grid, tile.grid.firstRow, tile.grid.firstCol, tile.grid.rowQuads, tile.grid.colQuads);
+			tile.mesh->renderMeshFromHeightmap(tile.lod.firstIndex, tile.lod.numStrips, tile.lod.numVertsPerStrip, drawMode);
+		}
+	}
+
+	glUniform4i(terrainUniforms.grid, 0, 0, 0, 0);
+}
+
+void TerrainStreamer::loaderLoop()
+{
+	while (true)
+	{
+		long long key;
+
+		{
+			std::unique_lock<std::mutex> lock(queueMutex);
+			queueCondition.wait(lock, [this]
+			{
+				return stopping || (!requestQueue.empty() && completedQueue.size() < TERRAIN_MAX_COMPLETED_TILES);
+			});
+
+			if (stopping)
+			{
+				return;
+			}
+
+			key = requestQueue.front();
+			requestQueue.pop_front();
+			inFlightTile = key;
+		}
+
+		// The slow part happens outside the lock
+		LoadedTerrainTile* tile = loadTile(key);
+
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			completedQueue.push_back(tile);
+			inFlightTile = -1;
+		}
+	}
+}
+
+LoadedTerrainTile* TerrainStreamer::loadTile(long long key)
+{
+	LoadedTerrainTile* tile = new LoadedTerrainTile();
+	tile->key = key;
+	tile->failed = false;
+
+	int width = source->getWidth();
+	int height = source->getHeight();
+	unsigned int firstRow = getTileRow(key) * tileSize;
+	unsigned int firstCol = getTileCol(key) * tileSize;
+	unsigned int rowQuads = std::min(firstRow + tileSize, (unsigned int)height - 1) - firstRow;
+	unsigned int colQuads = std::min(firstCol + tileSize, (unsigned int)width - 1) - firstCol;
+
+	// Read one extra sample around the tile where the map has one, so edge normals
+	// come out the same as they would for the whole map
+	unsigned int borderTop = firstRow > 0 ? 1 : 0;
+	unsigned int borderLeft = firstCol > 0 ? 1 : 0;
+	unsigned int borderBottom = firstRow + rowQuads + 1 < (unsigned int)height ? 1 : 0;
+	unsigned int borderRight = firstCol + colQuads + 1 < (unsigned int)width ? 1 : 0;
+	unsigned int readRows = borderTop + rowQuads + 1 + borderBottom;
+	unsigned int readCols = borderLeft + colQuads + 1 + borderRight;
+
+	std::vector<float> samples;
+	if (!source->readRegion(firstRow - borderTop, firstCol - borderLeft, readRows, readCols, samples))
+	{
+		tile->failed = true;
+		return tile;
+	}
+
+	for (size_t i = 0; i < samples.size(); i++)
+	{
+		samples[i] = samples[i] * heightScale - heightShift;
+	}
+
+	std::vector<GLuint> normals;
+	normalGenerator.generateNormals(&samples[0], 1, readCols, readRows, normals);
+
+	// Same placement as the full heightmap, so tiles line up with each other
+	std::vector<float> positions;
+	positions.reserve(samples.size() * 3);
+
+	for (unsigned int i = 0; i < readRows; i++)
+	{
+		for (unsigned int j = 0; j < readCols; j++)
+		{
+			positions.push_back(-height / 2.0f + (float)(firstRow - borderTop + i));
+			positions.push_back(samples[(size_t)i * readCols + j]);
+			positions.push_back(-width / 2.0f + (float)(firstCol - borderLeft + j));
+		}
+	}
+
+	// The border is only there for the normals, so the tile itself starts one sample in
+	size_t tileStart = (size_t)borderTop * readCols + borderLeft;
+
+	TerrainChunkBuilder builder(1, quantization);
+	builder.build(&positions[tileStart * 3], &normals[tileStart], readCols, rowQuads, colQuads, tile->geometry);
+
+	return tile;
+}
+
+void TerrainStreamer::stop()
+{
+	if (loader.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			stopping = true;
+		}
+		queueCondition.notify_all();
+		loader.join();
+	}
+
+	for (size_t i = 0; i < completedQueue.size(); i++)
+	{
+		delete completedQueue[i];
+	}
+	completedQueue.clear();
+	requestQueue.clear();
+	inFlightTile = -1;
+
+	for (auto it = residentTiles.begin(); it != residentTiles.end(); ++it)
+	{
+		delete it->second.mesh;
+	}
+	residentTiles.clear();
+	requestedTiles.clear();
+	failedTiles.clear();
+	lru.clear();
+	residentBytes = 0;
+	source = nullptr;
+}
+
+unsigned int TerrainStreamer::getHits()
+{
+	return hits;
+}
+
+unsigned int TerrainStreamer::getMisses()
+{
+	return misses;
+}
+
+unsigned int TerrainStreamer::getEvictions()
+{
+	return evictions;
+}
+
+unsigned int TerrainStreamer::getResidentTileCount()
+{
+	return residentTiles.size();
+}
+
+size_t TerrainStreamer::getResidentBytes()
+{
+	return residentBytes;
+}
+
+void TerrainStreamer::reportStats()
+{
+	printf("Terrain streaming: %u tiles resident (%.1f / %.1f MB), %u hits, %u misses, %u evictions\n",
+		getResidentTileCount(), residentBytes / (1024.0 * 1024.0), budget / (1024.0 * 1024.0), hits, misses, evictions);
+}
+
+TerrainStreamer::~TerrainStreamer()
+{
+	stop();
+}
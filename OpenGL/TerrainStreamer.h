@@ -0,0 +1,100 @@
+#pragma once
+
+#include <list>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <unordered_map>
+#include <unordered_set>
+
+#include <glm\glm.hpp>
+
+#include "Mesh.h"
+#include "Frustum.h"
+#include "HeightmapTileSource.h"
+#include "HeightmapGenerator.h"
+#include "TerrainChunkBuilder.h"
+
+// A tile that the loader thread has read and meshed, waiting to be uploaded
+struct LoadedTerrainTile
+{
+	long long key;
+	bool failed;
+	TerrainChunkGeometry geometry;
+};
+
+// A tile whose mesh is on the GPU
+struct ResidentTerrainTile
+{
+	Mesh* mesh;
+	glm::vec3 minBounds;
+	glm::vec3 maxBounds;
+	TerrainLodLevel lod;
+	TerrainChunkGrid grid;
+	size_t bytes;
+	unsigned int lastWantedFrame;
+	std::list<long long>::iterator lruPosition;
+};
+
+// Pages terrain tiles in and out around the camera.
+// A background thread reads and meshes tiles; the render thread only uploads
+// a few finished tiles per frame and evicts the least recently used ones
+// once the memory budget is exceeded, so it never waits on I/O.
+class TerrainStreamer
+{
+public:
+	TerrainStreamer();
+
+	void start(HeightmapTileSource* tileSource, unsigned int tileQuads, size_t memoryBudget, unsigned int loadRadius,
+		float yScale, float yShift);
+	void update(const glm::vec3& eyePosition, unsigned int maxUploadsPerFrame);
+	void render(const glm::mat4& clipMatrix, TerrainDrawMode drawMode, const TerrainUniforms& terrainUniforms);
+	void stop();
+
+	unsigned int getHits();
+	unsigned int getMisses();
+	unsigned int getEvictions();
+	unsigned int getResidentTileCount();
+	size_t getResidentBytes();
+	void reportStats();
+
+	~TerrainStreamer();
+
+private:
+	HeightmapTileSource* source;
+	unsigned int tileSize, radius;
+	unsigned int tileRows, tileCols;
+	size_t budget;
+	float heightScale, heightShift;
+	TerrainQuantization quantization;
+
+	// Render thread only
+	std::unordered_map<long long, ResidentTerrainTile> residentTiles;
+	std::list<long long> lru;
+	std::unordered_set<long long> requestedTiles;
+	std::unordered_set<long long> failedTiles;
+	size_t residentBytes;
+	unsigned int frame;
+	unsigned int hits, misses, evictions;
+	bool budgetWarningShown;
+	Frustum frustum;
+
+	// Loader thread only. Tiles are small, so normals are generated on the loader itself.
+	HeightmapGenerator normalGenerator;
+
+	// Shared with the loader thread, guarded by queueMutex
+	std::thread loader;
+	std::mutex queueMutex;
+	std::condition_variable queueCondition;
+	std::deque<long long> requestQueue;
+	std::deque<LoadedTerrainTile*> completedQueue;
+	long long inFlightTile;
+	bool stopping;
+
+	void loaderLoop();
+	LoadedTerrainTile* loadTile(long long key);
+	void uploadCompletedTiles(unsigned int maxUploads);
+	void evictTiles();
+};
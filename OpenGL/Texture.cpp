@@ -3,18 +3,22 @@
 Texture::Texture()
 {
 	textureID = 0;
+	pendingTextureID = 0;
 	width = 0;
 	height = 0;
 	bitDepth = 0;
+	loaded = false;
 	fileLocation = (char*)"";
 }
 
 Texture::Texture(char* fileLoc)
 {
 	textureID = 0;
+	pendingTextureID = 0;
 	width = 0;
 	height = 0;
 	bitDepth = 0;
+	loaded = false;
 	fileLocation = fileLoc;
 }
 
@@ -27,36 +31,100 @@ void Texture::LoadTexture()
 		return;
 	}
 
-	glGenTextures(1, &textureID);
-	glBindTexture(GL_TEXTURE_2D, textureID);
-
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	BindNewTexture(textureID);
 
 	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, texData);
 	glGenerateMipmap(GL_TEXTURE_2D);
 
-	glBindTexture(GL_TEXTURE_2D, 0);
-
 	stbi_image_free(texData);
+	loaded = true;
+}
+
+void Texture::CreatePlaceholder()
+{
+	// A single white texel, so anything sampling it looks untextured until the real image arrives
+	const unsigned char white[4] = { 255, 255, 255, 255 };
+
+	BindNewTexture(textureID);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, white);
+
+	loaded = false;
+}
+
+void Texture::AllocateStorage(int texWidth, int texHeight)
+{
+	width = texWidth;
+	height = texHeight;
+	bitDepth = 4;
+
+	// Rows go into a second texture object, so the placeholder stays on screen until every row is in
+	BindNewTexture(pendingTextureID);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+}
+
+void Texture::UploadRows(int firstRow, int numRows, const void* pixels)
+{
+	// pixels is an offset into the bound GL_PIXEL_UNPACK_BUFFER when there is one
+	GLStateCache::bindTexture(0, GL_TEXTURE_2D, pendingTextureID);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, firstRow, width, numRows, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+}
+
+void Texture::FinishUpload()
+{
+	GLStateCache::bindTexture(0, GL_TEXTURE_2D, pendingTextureID);
+	glGenerateMipmap(GL_TEXTURE_2D);
+
+	// Swap the finished texture in for the placeholder
+	glDeleteTextures(1, &textureID);
+	GLStateCache::forgetTexture(textureID);
+	textureID = pendingTextureID;
+	pendingTextureID = 0;
+
+	loaded = true;
+}
+
+const char* Texture::GetFileLocation()
+{
+	return fileLocation;
+}
+
+bool Texture::IsLoaded()
+{
+	return loaded;
+}
+
+void Texture::BindNewTexture(GLuint& id)
+{
+	if (id == 0)
+	{
+		glGenTextures(1, &id);
+	}
+	GLStateCache::bindTexture(0, GL_TEXTURE_2D, id);
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 }
 
 void Texture::UseTexture()
 {
 	// When being run in the shader there is a sampler which has access to the data.
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, textureID);
+	GLStateCache::bindTexture(0, GL_TEXTURE_2D, textureID);
 }
 
 void Texture::ClearTexture()
 {
 	glDeleteTextures(1, &textureID);
+	glDeleteTextures(1, &pendingTextureID);
+	GLStateCache::forgetTexture(textureID);
+	GLStateCache::forgetTexture(pendingTextureID);
 	textureID = 0;
+	pendingTextureID = 0;
 	width = 0;
 	height = 0;
 	bitDepth = 0;
+	loaded = false;
 	fileLocation = (char*)"";
 }
 
@@ -3,6 +3,7 @@
 
 #include <stdio.h>
 #include "stb_image.h"
+#include "GLStateCache.h"
 
 class Texture
 {
@@ -14,11 +15,24 @@ public:
 	void UseTexture();
 	void ClearTexture();
 
+	// Streaming uploads, used by AssetLoader. Data is always RGBA8.
+	void CreatePlaceholder();
+	void AllocateStorage(int texWidth, int texHeight);
+	void UploadRows(int firstRow, int numRows, const void* pixels);
+	void FinishUpload();
+
+	const char* GetFileLocation();
+	bool IsLoaded();
+
 	~Texture();
 
 private:
 	GLuint textureID;
+	GLuint pendingTextureID;
 	int width, height, bitDepth;
+	bool loaded;
 
 	char* fileLocation;
-};
\ No newline at end of file
+
+	void BindNewTexture(GLuint& id);
+};
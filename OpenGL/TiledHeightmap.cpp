@@ -0,0 +1,237 @@
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+#include "TiledHeightmap.h"
+
+static_assert(sizeof(TiledHeightmapHeader) == 32, "TiledHeightmapHeader must match the file layout");
+
+TiledHeightmap::TiledHeightmap()
+{
+	fileLocation = "";
+	header = nullptr;
+	tileOffsets = nullptr;
+}
+
+TiledHeightmap::TiledHeightmap(const char* fileLoc)
+{
+	fileLocation = fileLoc;
+	header = nullptr;
+	tileOffsets = nullptr;
+}
+
+bool TiledHeightmap::open()
+{
+	close();
+
+	if (!file.open(fileLocation.c_str()))
+	{
+		printf("Failed to open tiled heightmap: %s\n", fileLocation.c_str());
+		return false;
+	}
+
+	if (file.getSize() < sizeof(TiledHeightmapHeader))
+	{
+		printf("Tiled heightmap is too small: %s\n", fileLocation.c_str());
+		close();
+		return false;
+	}
+
+	header = (const TiledHeightmapHeader*)file.getData();
+
+	if (memcmp(header->magic, TILED_HEIGHTMAP_MAGIC, 4) != 0 || header->version != TILED_HEIGHTMAP_VERSION)
+	{
+		printf("Not a tiled heightmap: %s\n", fileLocation.c_str());
+		close();
+		return false;
+	}
+
+	// The tile grid has to cover the whole map, or sample lookups would run off the end of the index
+	if (header->tileSize == 0 || header->width == 0 || header->height == 0 ||
+		header->tileRows < ((uint64_t)header->height + header->tileSize - 1) / header->tileSize ||
+		header->tileCols < ((uint64_t)header->width + header->tileSize - 1) / header->tileSize)
+	{
+		printf("Tiled heightmap has an invalid tile grid: %s\n", fileLocation.c_str());
+		close();
+		return false;
+	}
+
+	// Make sure the index and every tile it points to are inside the file
+	size_t numTiles = (size_t)header->tileRows * header->tileCols;
+	size_t tileBytes = (size_t)header->tileSize * header->tileSize * sizeof(uint16_t);
+
+	// Compared by division first, so a huge tile count can't wrap indexEnd
+	if (numTiles > (file.getSize() - sizeof(TiledHeightmapHeader)) / sizeof(uint64_t))
+	{
+		printf("Tiled heightmap index is truncated: %s\n", fileLocation.c_str());
+		close();
+		return false;
+	}
+
+	size_t indexEnd = sizeof(TiledHeightmapHeader) + numTiles * sizeof(uint64_t);
+
+	tileOffsets = (const uint64_t*)(file.getData() + sizeof(TiledHeightmapHeader));
+
+	for (size_t i = 0; i < numTiles; i++)
+	{
+		// Written as a subtraction so an offset near the top of the range can't wrap around
+		if (tileOffsets[i] < indexEnd || tileOffsets[i] > file.getSize() || tileBytes > file.getSize() - tileOffsets[i] ||
+			tileOffsets[i] % sizeof(uint16_t) != 0)
+		{
+			printf("Tiled heightmap tile %zu is out of range: %s\n", i, fileLocation.c_str());
+			close();
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void TiledHeightmap::close()
+{
+	file.close();
+	header = nullptr;
+	tileOffsets = nullptr;
+}
+
+int TiledHeightmap::getWidth()
+{
+	return header ? header->width : 0;
+}
+
+int TiledHeightmap::getHeight()
+{
+	return header ? header->height : 0;
+}
+
+unsigned int TiledHeightmap::getTileSize()
+{
+	return header ? header->tileSize : 0;
+}
+
+const uint16_t* TiledHeightmap::getTile(unsigned int tileRow, unsigned int tileCol)
+{
+	if (!header || tileRow >= header->tileRows || tileCol >= header->tileCols)
+	{
+		return nullptr;
+	}
+
+	return (const uint16_t*)(file.getData() + tileOffsets[(size_t)tileRow * header->tileCols + tileCol]);
+}
+
+uint16_t TiledHeightmap::getSample(unsigned int row, unsigned int col)
+{
+	if (!header || row >= header->height || col >= header->width)
+	{
+		return 0;
+	}
+
+	unsigned int tileSize = header->tileSize;
+	return getTile(row / tileSize, col / tileSize)[(row % tileSize) * tileSize + col % tileSize];
+}
+
+bool TiledHeightmap::readRegion(unsigned int firstRow, unsigned int firstCol, unsigned int numRows, unsigned int numCols,
+	std::vector<float>& samples)
+{
+	if (!header || firstRow + numRows > header->height || firstCol + numCols > header->width)
+	{
+		return false;
+	}
+
+	unsigned int tileSize = header->tileSize;
+	samples.resize((size_t)numRows * numCols);
+
+	for (unsigned int i = 0; i < numRows; i++)
+	{
+		unsigned int row = firstRow + i;
+		float* out = &samples[(size_t)i * numCols];
+
+		// Copy the row a tile-wide run at a time, back into 8-bit height units
+		for (unsigned int col = firstCol; col < firstCol + numCols;)
+		{
+			unsigned int runEnd = std::min((col / tileSize + 1) * tileSize, firstCol + numCols);
+			const uint16_t* tileRow = getTile(row / tileSize, col / tileSize) + (row % tileSize) * tileSize;
+
+			for (; col < runEnd; col++)
+			{
+				*out++ = tileRow[col % tileSize] / 257.0f;
+			}
+		}
+	}
+
+	return true;
+}
+
+bool TiledHeightmap::write(const char* fileLoc, const uint16_t* samples, unsigned int mapWidth, unsigned int mapHeight, unsigned int tileSamples)
+{
+	if (mapWidth == 0 || mapHeight == 0 || tileSamples == 0)
+	{
+		return false;
+	}
+
+	FILE* output = fopen(fileLoc, "wb");
+	if (!output)
+	{
+		printf("Failed to create %s\n", fileLoc);
+		return false;
+	}
+
+	TiledHeightmapHeader fileHeader;
+	memcpy(fileHeader.magic, TILED_HEIGHTMAP_MAGIC, 4);
+	fileHeader.version = TILED_HEIGHTMAP_VERSION;
+	fileHeader.width = mapWidth;
+	fileHeader.height = mapHeight;
+	fileHeader.tileSize = tileSamples;
+	fileHeader.tileRows = (mapHeight + tileSamples - 1) / tileSamples;
+	fileHeader.tileCols = (mapWidth + tileSamples - 1) / tileSamples;
+	fileHeader.reserved = 0;
+
+	size_t numTiles = (size_t)fileHeader.tileRows * fileHeader.tileCols;
+	size_t tileBytes = (size_t)tileSamples * tileSamples * sizeof(uint16_t);
+	uint64_t firstTile = sizeof(TiledHeightmapHeader) + numTiles * sizeof(uint64_t);
+
+	std::vector<uint64_t> offsets(numTiles);
+	for (size_t i = 0; i < numTiles; i++)
+	{
+		offsets[i] = firstTile + i * tileBytes;
+	}
+
+	bool written = fwrite(&fileHeader, sizeof(fileHeader), 1, output) == 1 &&
+		fwrite(&offsets[0], sizeof(uint64_t), numTiles, output) == numTiles;
+
+	std::vector<uint16_t> tile((size_t)tileSamples * tileSamples);
+
+	for (unsigned int tileRow = 0; written && tileRow < fileHeader.tileRows; tileRow++)
+	{
+		for (unsigned int tileCol = 0; written && tileCol < fileHeader.tileCols; tileCol++)
+		{
+			for (unsigned int i = 0; i < tileSamples; i++)
+			{
+				// Pad past the edge of the map with the last row/column
+				unsigned int row = std::min(tileRow * tileSamples + i, mapHeight - 1);
+
+				for (unsigned int j = 0; j < tileSamples; j++)
+				{
+					unsigned int col = std::min(tileCol * tileSamples + j, mapWidth - 1);
+					tile[(size_t)i * tileSamples + j] = samples[(size_t)row * mapWidth + col];
+				}
+			}
+
+			written = fwrite(&tile[0], sizeof(uint16_t), tile.size(), output) == tile.size();
+		}
+	}
+
+	fclose(output);
+
+	if (!written)
+	{
+		printf("Failed to write %s\n", fileLoc);
+	}
+
+	return written;
+}
+
+TiledHeightmap::~TiledHeightmap()
+{
+	close();
+}
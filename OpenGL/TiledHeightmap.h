@@ -0,0 +1,66 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "HeightmapTileSource.h"
+#include "MappedFile.h"
+
+/*
+	Tiled heightmap file (.hmt), little-endian:
+
+	TiledHeightmapHeader
+	uint64_t tileOffsets[tileRows * tileCols]    byte offset of each tile, row-major
+	tiles                                        tileSize * tileSize uint16_t samples each,
+	                                             edge tiles padded by repeating the last sample
+
+	Samples cover the full 16-bit range. 8-bit sources are stored as value * 257.
+*/
+struct TiledHeightmapHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t width;
+	uint32_t height;
+	uint32_t tileSize;
+	uint32_t tileRows;
+	uint32_t tileCols;
+	uint32_t reserved;
+};
+
+const char TILED_HEIGHTMAP_MAGIC[4] = { 'H', 'M', 'T', '1' };
+const uint32_t TILED_HEIGHTMAP_VERSION = 1;
+
+// Memory-mapped .hmt heightmap. Tiles are read straight out of the mapping without copying.
+class TiledHeightmap : public HeightmapTileSource
+{
+public:
+	TiledHeightmap();
+	TiledHeightmap(const char* fileLoc);
+
+	bool open();
+	void close();
+
+	int getWidth();
+	int getHeight();
+	unsigned int getTileSize();
+
+	// Null if the tile is outside the map
+	const uint16_t* getTile(unsigned int tileRow, unsigned int tileCol);
+	// 0 outside the map
+	uint16_t getSample(unsigned int row, unsigned int col);
+
+	bool readRegion(unsigned int firstRow, unsigned int firstCol, unsigned int numRows, unsigned int numCols,
+		std::vector<float>& samples);
+
+	static bool write(const char* fileLoc, const uint16_t* samples, unsigned int mapWidth, unsigned int mapHeight, unsigned int tileSamples);
+
+	~TiledHeightmap();
+
+private:
+	std::string fileLocation;
+	MappedFile file;
+	const TiledHeightmapHeader* header;
+	const uint64_t* tileOffsets;
+};
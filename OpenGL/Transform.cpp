@@ -0,0 +1,138 @@
+#include "Transform.h"
+
+Transform::Transform()
+{
+	position = glm::vec3(0.0f);
+	rotation = glm::vec3(0.0f);
+	scale = glm::vec3(1.0f);
+
+	parent = nullptr;
+	parentVersion = 0;
+
+	worldMatrix = glm::mat4(1.0f);
+	version = 0;
+	dirty = true;
+}
+
+Transform::Transform(glm::vec3 startPosition, glm::vec3 startRotation, glm::vec3 startScale)
+{
+	position = startPosition;
+	rotation = startRotation;
+	scale = startScale;
+
+	parent = nullptr;
+	parentVersion = 0;
+
+	worldMatrix = glm::mat4(1.0f);
+	version = 0;
+	dirty = true;
+}
+
+// Setting the same value again doesn't dirty the matrix
+void Transform::setPosition(glm::vec3 newPosition)
+{
+	if (newPosition != position)
+	{
+		position = newPosition;
+		dirty = true;
+	}
+}
+
+void Transform::setRotation(glm::vec3 newRotation)
+{
+	if (newRotation != rotation)
+	{
+		rotation = newRotation;
+		dirty = true;
+	}
+}
+
+void Transform::setScale(glm::vec3 newScale)
+{
+	if (newScale != scale)
+	{
+		scale = newScale;
+		dirty = true;
+	}
+}
+
+void Transform::setParent(Transform* newParent)
+{
+	if (newParent != parent)
+	{
+		parent = newParent;
+		dirty = true;
+	}
+}
+
+glm::vec3 Transform::getPosition()
+{
+	return position;
+}
+
+glm::vec3 Transform::getRotation()
+{
+	return rotation;
+}
+
+glm::vec3 Transform::getScale()
+{
+	return scale;
+}
+
+const glm::mat4& Transform::getWorldMatrix()
+{
+	// The parent brings itself up to date first, which is what moves its version on
+	if (parent && parent->getVersion() != parentVersion)
+	{
+		dirty = true;
+	}
+
+	if (dirty)
+	{
+		update();
+	}
+
+	return worldMatrix;
+}
+
+unsigned int Transform::getVersion()
+{
+	if (parent)
+	{
+		getWorldMatrix();
+	}
+	else if (dirty)
+	{
+		update();
+	}
+
+	return version;
+}
+
+void Transform::update()
+{
+	glm::mat4 local = glm::translate(glm::mat4(1.0f), position);
+	local = glm::scale(local, scale);
+	local = glm::rotate(local, glm::radians(rotation.x), glm::vec3(1.0f, 0.0f, 0.0f));
+	local = glm::rotate(local, glm::radians(rotation.y), glm::vec3(0.0f, 1.0f, 0.0f));
+	local = glm::rotate(local, glm::radians(rotation.z), glm::vec3(0.0f, 0.0f, 1.0f));
+
+	if (parent)
+	{
+		// Read the parent's fields directly, getWorldMatrix would come back here
+		parentVersion = parent->version;
+		worldMatrix = parent->worldMatrix * local;
+	}
+	else
+	{
+		worldMatrix = local;
+	}
+
+	version++;
+	dirty = false;
+}
+
+Transform::~Transform()
+{
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <GL\glew.h>
+
+#include <glm\glm.hpp>
+#include <glm\gtc\matrix_transform.hpp>
+
+// Position, rotation (degrees about x, y then z) and scale, with the world matrix cached.
+// The matrix is only rebuilt after a setter changes something, or the parent's matrix changes,
+// so an object that doesn't move costs a version check per frame.
+// Composed as parent * translate * scale * rotateX * rotateY * rotateZ.
+class Transform
+{
+public:
+	Transform();
+	Transform(glm::vec3 startPosition, glm::vec3 startRotation, glm::vec3 startScale);
+
+	void setPosition(glm::vec3 newPosition);
+	void setRotation(glm::vec3 newRotation);
+	void setScale(glm::vec3 newScale);
+	// The parent has to outlive this transform
+	void setParent(Transform* newParent);
+
+	glm::vec3 getPosition();
+	glm::vec3 getRotation();
+	glm::vec3 getScale();
+
+	const glm::mat4& getWorldMatrix();
+	// Goes up every time the world matrix is rebuilt
+	unsigned int getVersion();
+
+	~Transform();
+
+private:
+	glm::vec3 position;
+	glm::vec3 rotation;
+	glm::vec3 scale;
+
+	Transform* parent;
+	unsigned int parentVersion;
+
+	glm::mat4 worldMatrix;
+	unsigned int version;
+	bool dirty;
+
+	void update();
+};
@@ -0,0 +1,267 @@
+#include <thread>
+#include <cmath>
+
+#include <glm\gtc\matrix_transform.hpp>
+#include <glm\gtc\matrix_inverse.hpp>
+
+// SSE2 is part of every x64 target, and of x86 builds with /arch:SSE2 or -msse2
+#if defined(_M_X64) || defined(__x86_64__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define TRANSFORM_KERNEL_SSE2
+#include <emmintrin.h>
+#endif
+
+#include "TransformKernel.h"
+
+// Below this many matrices per worker, starting the threads costs more than it saves
+const size_t TRANSFORM_KERNEL_MIN_PER_THREAD = 4096;
+
+#ifdef TRANSFORM_KERNEL_SSE2
+// a.yzx * b.zxy - a.zxy * b.yzx, done as one shuffle of each input and one of the result
+static inline __m128 cross4(__m128 a, __m128 b)
+{
+	__m128 aYzx = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1));
+	__m128 bYzx = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 2, 1));
+	__m128 c = _mm_sub_ps(_mm_mul_ps(a, bYzx), _mm_mul_ps(aYzx, b));
+	return _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 0, 2, 1));
+}
+
+static inline void storeColumn3(float* column, __m128 value)
+{
+	float lanes[4];
+	_mm_storeu_ps(lanes, value);
+	column[0] = lanes[0];
+	column[1] = lanes[1];
+	column[2] = lanes[2];
+}
+
+// left * column: a weighted sum of left's columns
+static inline __m128 transformColumn(__m128 left0, __m128 left1, __m128 left2, __m128 left3, __m128 column)
+{
+	return _mm_add_ps(
+		_mm_add_ps(_mm_mul_ps(left0, _mm_shuffle_ps(column, column, _MM_SHUFFLE(0, 0, 0, 0))),
+				   _mm_mul_ps(left1, _mm_shuffle_ps(column, column, _MM_SHUFFLE(1, 1, 1, 1)))),
+		_mm_add_ps(_mm_mul_ps(left2, _mm_shuffle_ps(column, column, _MM_SHUFFLE(2, 2, 2, 2))),
+				   _mm_mul_ps(left3, _mm_shuffle_ps(column, column, _MM_SHUFFLE(3, 3, 3, 3)))));
+}
+#endif
+
+TransformKernel::TransformKernel()
+{
+	threadCount = std::thread::hardware_concurrency();
+
+	// hardware_concurrency is allowed to report 0 when it can't tell
+	if (threadCount == 0)
+	{
+		threadCount = 1;
+	}
+
+	simdEnabled = true;
+}
+
+TransformKernel::TransformKernel(unsigned int numThreads)
+{
+	threadCount = numThreads > 0 ? numThreads : 1;
+	simdEnabled = true;
+}
+
+void TransformKernel::compose(const glm::mat4& parent, const glm::vec3* positions, const glm::vec3* rotations, const glm::vec3* scales,
+	const unsigned int* indices, size_t count, glm::mat4* worldMatrices, glm::mat3* normalMatrices)
+{
+	forEachRange(count, [&](size_t first, size_t last)
+	{
+		composeRange(parent, positions, rotations, scales, indices, first, last, worldMatrices, normalMatrices);
+	});
+}
+
+void TransformKernel::multiply(const glm::mat4& left, const glm::mat4* matrices, const unsigned int* indices, size_t count, glm::mat4* results)
+{
+	forEachRange(count, [&](size_t first, size_t last)
+	{
+		multiplyRange(left, matrices, indices, first, last, results);
+	});
+}
+
+void TransformKernel::composeRange(const glm::mat4& parent, const glm::vec3* positions, const glm::vec3* rotations, const glm::vec3* scales,
+	const unsigned int* indices, size_t first, size_t last, glm::mat4* worldMatrices, glm::mat3* normalMatrices)
+{
+#ifdef TRANSFORM_KERNEL_SSE2
+	if (simdEnabled)
+	{
+		const __m128 parent0 = _mm_loadu_ps(&parent[0][0]);
+		const __m128 parent1 = _mm_loadu_ps(&parent[1][0]);
+		const __m128 parent2 = _mm_loadu_ps(&parent[2][0]);
+		const __m128 parent3 = _mm_loadu_ps(&parent[3][0]);
+
+		for (size_t i = first; i < last; i++)
+		{
+			size_t index = indices ? indices[i] : i;
+			const glm::vec3& position = positions[index];
+			const glm::vec3& rotation = rotations[index];
+			const glm::vec3& scale = scales[index];
+
+			// Most objects only turn about one axis, if at all, so skip the trig for zero angles
+			float cx = 1.0f, sx = 0.0f, cy = 1.0f, sy = 0.0f, cz = 1.0f, sz = 0.0f;
+			if (rotation.x != 0.0f)
+			{
+				float angle = glm::radians(rotation.x);
+				cx = std::cos(angle);
+				sx = std::sin(angle);
+			}
+			if (rotation.y != 0.0f)
+			{
+				float angle = glm::radians(rotation.y);
+				cy = std::cos(angle);
+				sy = std::sin(angle);
+			}
+			if (rotation.z != 0.0f)
+			{
+				float angle = glm::radians(rotation.z);
+				cz = std::cos(angle);
+				sz = std::sin(angle);
+			}
+
+			// Columns of rotateX * rotateY * rotateZ, each row then scaled by the scale
+			__m128 scale4 = _mm_set_ps(0.0f, scale.z, scale.y, scale.x);
+			__m128 local0 = _mm_mul_ps(scale4, _mm_set_ps(0.0f, sx * sz - cx * sy * cz, cx * sz + sx * sy * cz, cy * cz));
+			__m128 local1 = _mm_mul_ps(scale4, _mm_set_ps(0.0f, sx * cz + cx * sy * sz, cx * cz - sx * sy * sz, -cy * sz));
+			__m128 local2 = _mm_mul_ps(scale4, _mm_set_ps(0.0f, cx * cy, -sx * cy, sy));
+
+			// parent * local. The w of the rotation columns is 0 and of the translation 1.
+			__m128 world0 = transformColumn(parent0, parent1, parent2, parent3, local0);
+			__m128 world1 = transformColumn(parent0, parent1, parent2, parent3, local1);
+			__m128 world2 = transformColumn(parent0, parent1, parent2, parent3, local2);
+			__m128 world3 = transformColumn(parent0, parent1, parent2, parent3, _mm_set_ps(1.0f, position.z, position.y, position.x));
+
+			glm::mat4& world = worldMatrices[index];
+			_mm_storeu_ps(&world[0][0], world0);
+			_mm_storeu_ps(&world[1][0], world1);
+			_mm_storeu_ps(&world[2][0], world2);
+			_mm_storeu_ps(&world[3][0], world3);
+
+			if (normalMatrices)
+			{
+				// The inverse's rows are the cofactor columns over the determinant,
+				// so its transpose has them as columns
+				__m128 cofactor0 = cross4(world1, world2);
+				__m128 cofactor1 = cross4(world2, world0);
+				__m128 cofactor2 = cross4(world0, world1);
+
+				float lanes[4];
+				_mm_storeu_ps(lanes, _mm_mul_ps(world0, cofactor0));
+				float determinant = lanes[0] + lanes[1] + lanes[2];
+				__m128 inverseDeterminant = _mm_set1_ps(determinant != 0.0f ? 1.0f / determinant : 0.0f);
+
+				glm::mat3& normalMatrix = normalMatrices[index];
+				storeColumn3(&normalMatrix[0][0], _mm_mul_ps(cofactor0, inverseDeterminant));
+				storeColumn3(&normalMatrix[1][0], _mm_mul_ps(cofactor1, inverseDeterminant));
+				storeColumn3(&normalMatrix[2][0], _mm_mul_ps(cofactor2, inverseDeterminant));
+			}
+		}
+		return;
+	}
+#endif
+
+	// One matrix at a time through GLM, the way the scene used to build them
+	for (size_t i = first; i < last; i++)
+	{
+		size_t index = indices ? indices[i] : i;
+
+		glm::mat4 local = glm::translate(glm::mat4(1.0f), positions[index]);
+		local = glm::scale(local, scales[index]);
+		local = glm::rotate(local, glm::radians(rotations[index].x), glm::vec3(1.0f, 0.0f, 0.0f));
+		local = glm::rotate(local, glm::radians(rotations[index].y), glm::vec3(0.0f, 1.0f, 0.0f));
+		local = glm::rotate(local, glm::radians(rotations[index].z), glm::vec3(0.0f, 0.0f, 1.0f));
+
+		worldMatrices[index] = parent * local;
+
+		if (normalMatrices)
+		{
+			normalMatrices[index] = glm::inverseTranspose(glm::mat3(worldMatrices[index]));
+		}
+	}
+}
+
+void TransformKernel::multiplyRange(const glm::mat4& left, const glm::mat4* matrices, const unsigned int* indices, size_t first, size_t last,
+	glm::mat4* results)
+{
+#ifdef TRANSFORM_KERNEL_SSE2
+	if (simdEnabled)
+	{
+		const __m128 left0 = _mm_loadu_ps(&left[0][0]);
+		const __m128 left1 = _mm_loadu_ps(&left[1][0]);
+		const __m128 left2 = _mm_loadu_ps(&left[2][0]);
+		const __m128 left3 = _mm_loadu_ps(&left[3][0]);
+
+		for (size_t i = first; i < last; i++)
+		{
+			size_t index = indices ? indices[i] : i;
+			const glm::mat4& right = matrices[index];
+			glm::mat4& result = results[index];
+
+			for (int column = 0; column < 4; column++)
+			{
+				_mm_storeu_ps(&result[column][0], transformColumn(left0, left1, left2, left3, _mm_loadu_ps(&right[column][0])));
+			}
+		}
+		return;
+	}
+#endif
+
+	for (size_t i = first; i < last; i++)
+	{
+		size_t index = indices ? indices[i] : i;
+		results[index] = left * matrices[index];
+	}
+}
+
+unsigned int TransformKernel::getThreadCount()
+{
+	return threadCount;
+}
+
+void TransformKernel::setSimdEnabled(bool enabled)
+{
+	simdEnabled = enabled;
+}
+
+bool TransformKernel::getSimdEnabled()
+{
+	return simdEnabled;
+}
+
+void TransformKernel::forEachRange(size_t count, std::function<void(size_t, size_t)> job)
+{
+	size_t numWorkers = count / TRANSFORM_KERNEL_MIN_PER_THREAD;
+	if (numWorkers > threadCount)
+	{
+		numWorkers = threadCount;
+	}
+
+	if (numWorkers <= 1)
+	{
+		job(0, count);
+		return;
+	}
+
+	// Each worker gets a contiguous block, so no two threads write the same matrix
+	std::vector<std::thread> workers;
+	size_t perWorker = count / numWorkers;
+	size_t extra = count % numWorkers;
+	size_t first = 0;
+
+	for (size_t w = 0; w < numWorkers; w++)
+	{
+		size_t last = first + perWorker + (w < extra ? 1 : 0);
+		workers.push_back(std::thread(job, first, last));
+		first = last;
+	}
+
+	for (size_t w = 0; w < workers.size(); w++)
+	{
+		workers[w].join();
+	}
+}
+
+TransformKernel::~TransformKernel()
+{
+}
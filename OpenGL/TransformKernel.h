@@ -0,0 +1,42 @@
+#pragma once
+
+#include <vector>
+#include <functional>
+
+#include <glm\glm.hpp>
+
+// Builds world matrices for many objects at once from separate position, rotation and scale arrays.
+// world = parent * translate * scale * rotateX * rotateY * rotateZ, rotations in degrees,
+// the same matrix the glm::translate / glm::scale / glm::rotate chain gives.
+// Rotations are expanded in closed form and the parent multiply is done with SSE.
+// Large batches are split across worker threads.
+class TransformKernel
+{
+public:
+	TransformKernel();
+	TransformKernel(unsigned int numThreads);
+
+	// Writes worldMatrices[i] for i in [0, count), or worldMatrices[indices[i]] when indices is given.
+	// normalMatrices, when given, gets the inverse transpose of each world matrix's upper 3x3.
+	void compose(const glm::mat4& parent, const glm::vec3* positions, const glm::vec3* rotations, const glm::vec3* scales,
+		const unsigned int* indices, size_t count, glm::mat4* worldMatrices, glm::mat3* normalMatrices);
+	// results[i] = left * matrices[i], indexed the same way as compose
+	void multiply(const glm::mat4& left, const glm::mat4* matrices, const unsigned int* indices, size_t count, glm::mat4* results);
+
+	unsigned int getThreadCount();
+	void setSimdEnabled(bool enabled);
+	bool getSimdEnabled();
+
+	~TransformKernel();
+
+private:
+	unsigned int threadCount;
+	bool simdEnabled;
+
+	void composeRange(const glm::mat4& parent, const glm::vec3* positions, const glm::vec3* rotations, const glm::vec3* scales,
+		const unsigned int* indices, size_t first, size_t last, glm::mat4* worldMatrices, glm::mat3* normalMatrices);
+	void multiplyRange(const glm::mat4& left, const glm::mat4* matrices, const unsigned int* indices, size_t first, size_t last,
+		glm::mat4* results);
+
+	void forEachRange(size_t count, std::function<void(size_t, size_t)> job);
+};
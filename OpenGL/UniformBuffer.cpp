@@ -0,0 +1,54 @@
+#include <stdio.h>
+
+#include "UniformBuffer.h"
+
+UniformBuffer::UniformBuffer()
+{
+	bufferID = 0;
+	binding = 0;
+	bufferSize = 0;
+}
+
+void UniformBuffer::create(GLuint bindingPoint, GLsizeiptr size)
+{
+	clear();
+
+	binding = bindingPoint;
+	bufferSize = size;
+
+	glGenBuffers(1, &bufferID);
+	GLStateCache::bindBuffer(GL_UNIFORM_BUFFER, bufferID);
+	glBufferData(GL_UNIFORM_BUFFER, size, nullptr, GL_DYNAMIC_DRAW);
+
+	// Stays attached for the life of the buffer, so updates never need to rebind the block
+	glBindBufferBase(GL_UNIFORM_BUFFER, binding, bufferID);
+}
+
+void UniformBuffer::update(const void* data, GLsizeiptr size)
+{
+	if (size > bufferSize)
+	{
+		printf("Uniform buffer update of %d bytes is larger than the %d byte buffer\n", (int)size, (int)bufferSize);
+		return;
+	}
+
+	GLStateCache::bindBuffer(GL_UNIFORM_BUFFER, bufferID);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, size, data);
+}
+
+void UniformBuffer::clear()
+{
+	if (bufferID != 0)
+	{
+		glDeleteBuffers(1, &bufferID);
+		GLStateCache::forgetBuffer(bufferID);
+		bufferID = 0;
+	}
+
+	bufferSize = 0;
+}
+
+UniformBuffer::~UniformBuffer()
+{
+	clear();
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <GL\glew.h>
+
+#include <glm\glm.hpp>
+
+#include "GLStateCache.h"
+
+// Binding points of the shared uniform blocks. Every Shader links its blocks to these.
+const GLuint FRAME_UNIFORM_BINDING = 0;
+const GLuint SCENE_UNIFORM_BINDING = 1;
+
+// std140 layout of the FrameData block, written once per frame.
+// The bool after the vec3 packs into the same vec4.
+struct FrameUniforms
+{
+	glm::mat4 projection;
+	glm::mat4 view;
+	glm::vec3 eyePosition;
+	GLint perVertexMatrices;
+};
+
+// std140 layout of the SceneData block. Matches the shader's DirectionalLight:
+// a vec3 followed by a float packs into one vec4.
+struct SceneUniforms
+{
+	glm::vec4 lightColour;    // rgb, ambient intensity
+	glm::vec4 lightDirection; // xyz, diffuse intensity
+};
+
+// A uniform buffer attached to a fixed binding point, so any program using the block sees it
+class UniformBuffer
+{
+public:
+	UniformBuffer();
+
+	void create(GLuint bindingPoint, GLsizeiptr size);
+	void update(const void* data, GLsizeiptr size);
+	void clear();
+
+	~UniformBuffer();
+
+private:
+	GLuint bufferID;
+	GLuint binding;
+	GLsizeiptr bufferSize;
+};
@@ -0,0 +1,74 @@
+#include "UniformNames.h"
+
+const UniformId UNIFORM_MODEL = UniformNames::intern("model");
+const UniformId UNIFORM_MVP = UniformNames::intern("mvp");
+const UniformId UNIFORM_NORMAL_MATRIX = UniformNames::intern("normalMatrix");
+const UniformId UNIFORM_SPECULAR_INTENSITY = UniformNames::intern("material.specularIntensity");
+const UniformId UNIFORM_SHININESS = UniformNames::intern("material.shininess");
+const UniformId UNIFORM_LOD_LEVEL = UniformNames::intern("lodLevel");
+const UniformId UNIFORM_MORPH_RANGE = UniformNames::intern("morphRange");
+const UniformId UNIFORM_POSITION_SCALE = UniformNames::intern("positionScale");
+const UniformId UNIFORM_POSITION_OFFSET = UniformNames::intern("positionOffset");
+const UniformId UNIFORM_TERRAIN_GRID = UniformNames::intern("terrainGrid");
+const UniformId UNIFORM_TERRAIN_LEVEL_COUNT = UniformNames::intern("terrainLevelCount");
+const UniformId UNIFORM_BASE_VERTEX = UniformNames::intern("baseVertex");
+const UniformId UNIFORM_INSTANCED = UniformNames::intern("instanced");
+const UniformId UNIFORM_INDIRECT = UniformNames::intern("indirect");
+const UniformId UNIFORM_DRAW_DATA_OFFSET = UniformNames::intern("drawDataOffset");
+
+// One entry per element, MAX_INSTANCE_MATERIALS of them
+const UniformId UNIFORM_INSTANCE_SPECULAR_INTENSITY[MAX_INSTANCE_MATERIALS] =
+{
+	UniformNames::intern("instanceMaterials[0].specularIntensity"),
+	UniformNames::intern("instanceMaterials[1].specularIntensity"),
+	UniformNames::intern("instanceMaterials[2].specularIntensity"),
+	UniformNames::intern("instanceMaterials[3].specularIntensity")
+};
+const UniformId UNIFORM_INSTANCE_SHININESS[MAX_INSTANCE_MATERIALS] =
+{
+	UniformNames::intern("instanceMaterials[0].shininess"),
+	UniformNames::intern("instanceMaterials[1].shininess"),
+	UniformNames::intern("instanceMaterials[2].shininess"),
+	UniformNames::intern("instanceMaterials[3].shininess")
+};
+
+static_assert(MAX_INSTANCE_MATERIALS == 4, "UNIFORM_INSTANCE_SPECULAR_INTENSITY and UNIFORM_INSTANCE_SHININESS need an entry per material");
+
+std::unordered_map<std::string, UniformId>& UniformNames::getIds()
+{
+	static std::unordered_map<std::string, UniformId> ids;
+	return ids;
+}
+
+std::vector<std::string>& UniformNames::getNames()
+{
+	static std::vector<std::string> names;
+	return names;
+}
+
+UniformId UniformNames::intern(const std::string& name)
+{
+	std::unordered_map<std::string, UniformId>& ids = getIds();
+
+	std::unordered_map<std::string, UniformId>::iterator found = ids.find(name);
+	if (found != ids.end())
+	{
+		return found->second;
+	}
+
+	std::vector<std::string>& names = getNames();
+	UniformId id = (UniformId)names.size();
+	names.push_back(name);
+	ids[name] = id;
+	return id;
+}
+
+const std::string& UniformNames::getName(UniformId id)
+{
+	return getNames()[id];
+}
+
+unsigned int UniformNames::getCount()
+{
+	return (unsigned int)getNames().size();
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+// Small id standing in for a uniform's name
+typedef unsigned int UniformId;
+
+// Interns uniform names into ids shared by every program. A Shader lists its active uniforms
+// once after linking and files each location under its name's id, so setting a uniform
+// is an array lookup and never touches a string.
+class UniformNames
+{
+public:
+	// Same name, same id. New names get the next id.
+	static UniformId intern(const std::string& name);
+	static const std::string& getName(UniformId id);
+	static unsigned int getCount();
+
+private:
+	// Function statics, so ids can be interned while other globals are being constructed
+	static std::unordered_map<std::string, UniformId>& getIds();
+	static std::vector<std::string>& getNames();
+};
+
+// Size of the instanceMaterials array in shader.frag
+const int MAX_INSTANCE_MATERIALS = 4;
+
+// Uniforms the engine sets. A shader can declare any others, they are interned when it links.
+extern const UniformId UNIFORM_MODEL;
+extern const UniformId UNIFORM_MVP;
+extern const UniformId UNIFORM_NORMAL_MATRIX;
+extern const UniformId UNIFORM_SPECULAR_INTENSITY;
+extern const UniformId UNIFORM_SHININESS;
+extern const UniformId UNIFORM_LOD_LEVEL;
+extern const UniformId UNIFORM_MORPH_RANGE;
+extern const UniformId UNIFORM_POSITION_SCALE;
+extern const UniformId UNIFORM_POSITION_OFFSET;
+extern const UniformId UNIFORM_TERRAIN_GRID;
+extern const UniformId UNIFORM_TERRAIN_LEVEL_COUNT;
+extern const UniformId UNIFORM_BASE_VERTEX;
+extern const UniformId UNIFORM_INSTANCED;
+extern const UniformId UNIFORM_INDIRECT;
+extern const UniformId UNIFORM_DRAW_DATA_OFFSET;
+extern const UniformId UNIFORM_INSTANCE_SPECULAR_INTENSITY[MAX_INSTANCE_MATERIALS];
+extern const UniformId UNIFORM_INSTANCE_SHININESS[MAX_INSTANCE_MATERIALS];